@@ -0,0 +1,124 @@
+// Parse cost of the command fast path `codec::DecodeJsonRequest()` against a json11 DOM, on a
+// trace of command payloads, one message per line as a client sent it. Messages the fast path
+// refuses fall back to json11, like the server does, so the numbers include that cost.
+//
+//   codec-parse [trace, default bench/traces/commands.jsonl] [iterations, default 2000]
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+
+#include "message-codec.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// the envelope fields a request handler reads, from either parser
+struct Fields {
+	int op = 0;
+	std::string requestType;
+	std::string requestId;
+	json11::Json requestData;
+};
+
+static bool ParseJson11(const std::string& payload, Fields& fields) {
+	std::string error;
+	json11::Json message = json11::Json::parse(payload, error);
+	if (!error.empty())
+		return false;
+
+	const json11::Json& d = message["d"];
+	fields.op = message["op"].int_value();
+	fields.requestType = d["requestType"].string_value();
+	fields.requestId = d["requestId"].string_value();
+	fields.requestData = d["requestData"];
+	return true;
+}
+
+// returns whether the fast path took the message
+static bool ParseFast(const std::string& payload, Fields& fields) {
+	codec::RequestMessage message;
+	if (!codec::DecodeJsonRequest(payload, message)) {
+		ParseJson11(payload, fields);
+		return false;
+	}
+
+	fields.op = message.op;
+	fields.requestType = std::move(message.requestType);
+	fields.requestId = std::move(message.requestId);
+	fields.requestData = std::move(message.requestData);
+	return true;
+}
+
+template<typename Parse> static double Measure(const std::vector<std::string>& trace,
+					      int iterations, Parse&& parse, size_t& checksum) {
+	auto startedAt = Clock::now();
+	for (int i = 0; i < iterations; i++) {
+		for (auto& payload : trace) {
+			Fields fields;
+			parse(payload, fields);
+			checksum += fields.requestType.size() + fields.requestId.size();
+		}
+	}
+	return std::chrono::duration<double, std::nano>(Clock::now() - startedAt).count();
+}
+
+int main(int argc, char** argv) {
+	const char* path = argc > 1 ? argv[1] : BENCH_TRACE_DIR "/commands.jsonl";
+	int iterations = argc > 2 ? std::max(1, atoi(argv[2])) : 2000;
+
+	std::ifstream file(path);
+	std::vector<std::string> trace;
+	size_t bytes = 0;
+	for (std::string line; std::getline(file, line);) {
+		if (line.empty())
+			continue;
+		bytes += line.size();
+		trace.push_back(std::move(line));
+	}
+	if (trace.empty()) {
+		fprintf(stderr, "no messages in %s\n", path);
+		return 1;
+	}
+
+	// both parsers must agree on every message the fast path takes
+	size_t fastMessages = 0;
+	for (auto& payload : trace) {
+		Fields fast;
+		Fields reference;
+		if (!ParseFast(payload, fast))
+			continue;
+		fastMessages++;
+
+		if (!ParseJson11(payload, reference) || fast.op != reference.op ||
+		    fast.requestType != reference.requestType ||
+		    fast.requestId != reference.requestId ||
+		    fast.requestData != reference.requestData) {
+			fprintf(stderr, "fast path differs from json11 on: %s\n", payload.c_str());
+			return 1;
+		}
+	}
+
+	size_t checksum = 0;
+	// warm up caches and the allocator
+	Measure(trace, 1, ParseJson11, checksum);
+	Measure(trace, 1, ParseFast, checksum);
+
+	double json11Ns = Measure(trace, iterations, ParseJson11, checksum);
+	double fastNs = Measure(trace, iterations, ParseFast, checksum);
+
+	double messages = double(trace.size()) * iterations;
+	double megabytes = double(bytes) * iterations / (1024.0 * 1024.0);
+	printf("%zu messages, %zu bytes, %.1f%% on the fast path, %d iterations\n", trace.size(),
+	       bytes, 100.0 * double(fastMessages) / double(trace.size()), iterations);
+	printf("%-10s %12s %10s\n", "parser", "ns/message", "MiB/s");
+	printf("%-10s %12.1f %10.1f\n", "json11", json11Ns / messages,
+	       megabytes / (json11Ns / 1e9));
+	printf("%-10s %12.1f %10.1f\n", "fast path", fastNs / messages,
+	       megabytes / (fastNs / 1e9));
+	printf("speedup %.2fx (checksum %zu)\n", json11Ns / fastNs, checksum);
+	return 0;
+}
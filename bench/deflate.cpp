@@ -0,0 +1,191 @@
+// CPU cost of permessage-deflate against the bytes it saves, on payloads shaped like what the
+// recorder sends: a full state dump, log lines and stats events. Compresses the way the
+// extension does, raw deflate with a sync flush and the trailing 00 00 ff ff stripped, for
+// every window size and with and without context takeover. Messages below the threshold go
+// out uncompressed and count as sent as they are.
+//
+//   deflate [messages per payload, default 2000] [threshold, default 1024]
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include <zlib.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Payload {
+	const char* name;
+	std::vector<std::string> messages;
+};
+
+// a `GetSceneList` response of a production with many sources
+static std::string StateDump(int seed) {
+	std::string json = R"({"op":7,"d":{"requestType":"GetSceneList","requestId":")" +
+			   std::to_string(seed) + R"(","requestStatus":{"result":true,"code":100},)"
+						  R"("responseData":{"scenes":[)";
+	for (int scene = 0; scene < 24; scene++) {
+		if (scene)
+			json += ",";
+		json += R"({"sceneName":"Scene )" + std::to_string(scene) + R"(","sceneIndex":)" +
+			std::to_string(scene) + R"(,"items":[)";
+		for (int item = 0; item < 12; item++) {
+			if (item)
+				json += ",";
+			int id = scene * 12 + item;
+			json += R"({"sceneItemId":)" + std::to_string(id) +
+				R"(,"sourceName":"Camera )" + std::to_string((id * 7 + seed) % 40) +
+				R"(","inputKind":"v4l2_input","sceneItemEnabled":)" +
+				(((id + seed) % 3) ? "true" : "false") +
+				R"(,"sceneItemTransform":{"positionX":)" +
+				std::to_string((id * 37 + seed) % 1920) + R"(,"positionY":)" +
+				std::to_string((id * 53) % 1080) +
+				R"(,"scaleX":1.0,"scaleY":1.0,"rotation":0.0,)"
+				R"("width":1920,"height":1080}})";
+		}
+		json += "]}";
+	}
+	json += "]}}}";
+	return json;
+}
+
+static std::string LogEvent(int seed) {
+	static const char* lines[] = {
+		"[x264 encoder: 'streaming_h264'] preset: veryfast",
+		"Output 'adv_stream': stopping",
+		"[rtmp stream: 'adv_stream'] Connection to rtmp://ingest.example.com/live "
+		"successful",
+		"[WebSocketServer::OnOpen] New WebSocket client has connected from 10.0.0.12",
+		"Video stopped, number of skipped frames due to encoding lag: 12/54000 (0.0%)",
+		"[pulse-input: 'Mic/Aux'] Started recording from 'alsa_input.usb-0d8c_0014'",
+	};
+	std::string json = R"({"op":5,"d":{"eventType":"Log","eventIntent":32,"eventData":)"
+			   R"({"entries":[)";
+	for (int i = 0; i < 16; i++) {
+		if (i)
+			json += ",";
+		long long time = 1700000000000LL + seed * 16 + i;
+		json += R"({"level":300,"time":)" + std::to_string(time) + R"(,"message":")" +
+			lines[(seed + i * 5) % 6] + "\"}";
+	}
+	json += "]}}}";
+	return json;
+}
+
+static std::string StatsEvent(int seed) {
+	return R"({"op":5,"d":{"eventType":"Stats","eventIntent":1,"eventData":{"cpuUsage":)" +
+	       std::to_string(12.0 + (seed % 97) / 10.0) +
+	       R"(,"memoryUsage":)" + std::to_string(812.5 + seed % 13) +
+	       R"(,"activeFps":60.0,"averageFrameRenderTime":)" +
+	       std::to_string(1.2 + (seed % 17) / 100.0) +
+	       R"(,"renderSkippedFrames":)" + std::to_string(seed / 100) +
+	       R"(,"renderTotalFrames":)" + std::to_string(seed * 60) +
+	       R"(,"outputSkippedFrames":0,"outputTotalFrames":)" + std::to_string(seed * 60) +
+	       "}}}";
+}
+
+struct Result {
+	double compressNs = 0.0;
+	double inflateNs = 0.0;
+	size_t inputBytes = 0;
+	size_t outputBytes = 0;
+	size_t compressed = 0;
+};
+
+static Result Run(const Payload& payload, int windowBits, bool contextTakeover,
+		  size_t threshold) {
+	z_stream deflater = {};
+	z_stream inflater = {};
+	deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -windowBits, 8,
+		     Z_DEFAULT_STRATEGY);
+	inflateInit2(&inflater, -15);
+
+	std::vector<unsigned char> out;
+	std::vector<unsigned char> back;
+	Result result;
+	for (auto& message : payload.messages) {
+		result.inputBytes += message.size();
+		if (message.size() < threshold) {
+			result.outputBytes += message.size();
+			continue;
+		}
+
+		out.resize(deflateBound(&deflater, message.size()) + 16);
+		auto startedAt = Clock::now();
+		if (!contextTakeover)
+			deflateReset(&deflater);
+		deflater.next_in = (Bytef*)message.data();
+		deflater.avail_in = (uInt)message.size();
+		deflater.next_out = out.data();
+		deflater.avail_out = (uInt)out.size();
+		deflate(&deflater, Z_SYNC_FLUSH);
+		// the extension strips the empty stored block the sync flush ends with
+		size_t size = out.size() - deflater.avail_out - 4;
+		result.compressNs +=
+		  std::chrono::duration<double, std::nano>(Clock::now() - startedAt).count();
+
+		// what the client pays, the stripped tail is still in `out` and goes back in
+		back.resize(message.size() + 64);
+		startedAt = Clock::now();
+		if (!contextTakeover)
+			inflateReset(&inflater);
+		inflater.next_in = out.data();
+		inflater.avail_in = (uInt)(size + 4);
+		inflater.next_out = back.data();
+		inflater.avail_out = (uInt)back.size();
+		inflate(&inflater, Z_SYNC_FLUSH);
+		result.inflateNs +=
+		  std::chrono::duration<double, std::nano>(Clock::now() - startedAt).count();
+
+		if (back.size() - inflater.avail_out != message.size()) {
+			fprintf(stderr, "%s: round trip lost data\n", payload.name);
+			exit(1);
+		}
+
+		result.outputBytes += size;
+		result.compressed++;
+	}
+
+	deflateEnd(&deflater);
+	inflateEnd(&inflater);
+	return result;
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? std::max(1, atoi(argv[1])) : 2000;
+	size_t threshold = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1024;
+
+	std::vector<Payload> payloads = {{"state dump", {}}, {"log", {}}, {"stats", {}}};
+	for (int i = 0; i < count; i++) {
+		payloads[0].messages.push_back(StateDump(i));
+		payloads[1].messages.push_back(LogEvent(i));
+		payloads[2].messages.push_back(StatsEvent(i));
+	}
+
+	printf("%d messages per payload, threshold %zu bytes\n", count, threshold);
+	printf("%-11s %4s %9s %10s %9s %12s %11s %11s\n", "payload", "bits", "takeover",
+	       "avg bytes", "ratio", "saved KiB", "deflate ns", "inflate ns");
+
+	for (auto& payload : payloads) {
+		for (int windowBits : {9, 11, 15}) {
+			for (bool contextTakeover : {false, true}) {
+				Result result =
+				  Run(payload, windowBits, contextTakeover, threshold);
+				double compressed = double(std::max<size_t>(result.compressed, 1));
+				printf("%-11s %4d %9s %10.0f %8.1f%% %12.1f %11.0f %11.0f\n",
+				       payload.name, windowBits, contextTakeover ? "on" : "off",
+				       double(result.inputBytes) / payload.messages.size(),
+				       100.0 * result.outputBytes / result.inputBytes,
+				       (result.inputBytes - result.outputBytes) / 1024.0,
+				       result.compressNs / compressed,
+				       result.inflateNs / compressed);
+			}
+		}
+		fflush(stdout);
+	}
+
+	return 0;
+}
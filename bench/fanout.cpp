@@ -0,0 +1,173 @@
+// In-process part of a broadcast: every event is serialized and prepared once, pushed into
+// the outbound queue of each session and drained by the IO thread that owns the session,
+// which copies header and payload out the way the socket write does. Shows how delivery
+// scales with the IO thread count; ws-load measures the same path through real sockets.
+//
+//   fanout [sessions, default 200] [payload bytes, default 1024] [seconds per step, default 2]
+//          [producers, default 2]
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <websocketpp/processors/hybi13.hpp>
+
+#include "websocket-config.h"
+#include "websocket-session.h"
+
+typedef WebSocketConfig::message_type::ptr Frame;
+typedef std::chrono::steady_clock Clock;
+
+// what the kernel takes per write, the copy is the cost the IO threads share
+static constexpr size_t kSocketBufferSize = 64 * 1024;
+
+struct BenchSession {
+	SessionOutboundQueue queue;
+	std::vector<char> socketBuffer = std::vector<char>(kSocketBufferSize);
+};
+
+// same as `WebSocketServer::MakeSharedFrame()`, prepared once for every session
+static Frame PrepareFrame(const std::string& payload) {
+	typedef websocketpp::config::asio config;
+
+	auto manager = websocketpp::lib::make_shared<config::con_msg_manager_type>();
+	auto message = manager->get_message(websocketpp::frame::opcode::text, payload.size());
+	message->set_payload(payload);
+
+	config::rng_type rng;
+	websocketpp::processor::hybi13<config> processor(false, true, manager, rng);
+	Frame frame = manager->get_message();
+	if (processor.prepare_data_frame(message, frame))
+		return nullptr;
+	return frame;
+}
+
+struct StepResult {
+	double seconds = 0.0;
+	uint64_t broadcasts = 0;
+	uint64_t delivered = 0;
+	uint64_t deliveredBytes = 0;
+	uint64_t dropped = 0;
+};
+
+static StepResult RunStep(size_t sessionCount, size_t ioThreads, size_t producers,
+			  const std::string& payload, int seconds) {
+	std::vector<std::unique_ptr<BenchSession>> sessions;
+	for (size_t i = 0; i < sessionCount; i++)
+		sessions.push_back(std::make_unique<BenchSession>());
+
+	SessionOutboundQueue::Limits limits{WebSocketBackpressure::maxQueuedBytes,
+					    WebSocketBackpressure::maxQueuedMessages,
+					    SlowConsumerPolicy::DropOldest,
+					    EventSubscription::Snapshots};
+
+	std::atomic<bool> running = true;
+	std::atomic<uint64_t> broadcasts = 0;
+	std::atomic<uint64_t> delivered = 0;
+	std::atomic<uint64_t> deliveredBytes = 0;
+
+	// a session belongs to one IO thread, as a connection belongs to its strand
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < ioThreads; t++) {
+		threads.emplace_back([&, t]() {
+			uint64_t messages = 0;
+			uint64_t bytes = 0;
+			while (running) {
+				bool idle = true;
+				for (size_t i = t; i < sessions.size(); i += ioThreads) {
+					BenchSession& session = *sessions[i];
+					auto ready = []() { return true; };
+					session.queue.Drain(ready, [&](const Frame& frame) {
+						const std::string& header = frame->get_header();
+						const std::string& data = frame->get_payload();
+						size_t room = kSocketBufferSize - header.size();
+						char* out = session.socketBuffer.data();
+						memcpy(out, header.data(), header.size());
+						memcpy(out + header.size(), data.data(),
+						       std::min(data.size(), room));
+						messages++;
+						bytes += header.size() + data.size();
+						idle = false;
+					});
+				}
+				if (idle)
+					std::this_thread::yield();
+			}
+			delivered += messages;
+			deliveredBytes += bytes;
+		});
+	}
+
+	// the UI thread, libobs signal threads and the output thread all broadcast
+	std::vector<std::thread> producerThreads;
+	for (size_t p = 0; p < producers; p++) {
+		producerThreads.emplace_back([&]() {
+			uint64_t count = 0;
+			while (running) {
+				Frame frame = PrepareFrame(payload);
+				size_t bytes = frame->get_header().size() +
+					       frame->get_payload().size();
+				for (auto& session : sessions)
+					session->queue.Push(frame, bytes, EventSubscription::Stats,
+							    limits);
+				count++;
+			}
+			broadcasts += count;
+		});
+	}
+
+	auto startedAt = Clock::now();
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	running = false;
+	for (auto& thread : producerThreads)
+		thread.join();
+	for (auto& thread : threads)
+		thread.join();
+
+	StepResult result;
+	result.seconds = std::chrono::duration<double>(Clock::now() - startedAt).count();
+	result.broadcasts = broadcasts;
+	result.delivered = delivered;
+	result.deliveredBytes = deliveredBytes;
+	for (auto& session : sessions)
+		result.dropped += session->queue.Dropped();
+	return result;
+}
+
+int main(int argc, char** argv) {
+	size_t sessionCount = argc > 1 ? std::max(1, atoi(argv[1])) : 200;
+	size_t payloadBytes = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1024;
+	int seconds = argc > 3 ? std::max(1, atoi(argv[3])) : 2;
+	size_t producers = argc > 4 ? std::max(1, atoi(argv[4])) : 2;
+
+	// a stats event padded to the payload size
+	std::string payload = R"({"op":5,"d":{"eventType":"Stats","eventData":{"pad":")";
+	payload.append(payloadBytes > payload.size() + 5 ? payloadBytes - payload.size() - 5 : 0,
+		       'x');
+	payload += R"("}}})";
+
+	printf("%zu sessions, %zu byte events, %zu producers\n", sessionCount, payload.size(),
+	       producers);
+	printf("%-10s %14s %14s %10s %12s\n", "IO threads", "broadcasts/s", "delivered/s",
+	       "MiB/s", "dropped");
+
+	size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	for (size_t ioThreads = 1; ioThreads <= std::min<size_t>(maxThreads, 16); ioThreads *= 2) {
+		StepResult result = RunStep(sessionCount, ioThreads, producers, payload, seconds);
+		printf("%-10zu %14.0f %14.0f %10.1f %12llu\n", ioThreads,
+		       double(result.broadcasts) / result.seconds,
+		       double(result.delivered) / result.seconds,
+		       double(result.deliveredBytes) / result.seconds / (1024.0 * 1024.0),
+		       (unsigned long long)result.dropped);
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+// Session lookups under concurrent readers: `SessionRegistry` against the map behind one mutex it
+// replaced, keyed by connection handle and looked up through `at()`. Reader threads stand in for
+// the IO threads, each looks up the session of an incoming message and every 64th lookup walks
+// all sessions like a broadcast does. One writer keeps clients reconnecting meanwhile.
+//
+//   registry [sessions, default 200] [seconds per step, default 1] [reconnects/s, default 100]
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+
+#include "session-registry.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// every 64th operation is a broadcast over all sessions
+static constexpr uint32_t kBroadcastEvery = 64;
+
+// a connection the way websocketpp hands it out, the handle is a weak pointer to it
+struct Client {
+	std::shared_ptr<int> connection = std::make_shared<int>(0);
+	websocketpp::connection_hdl hdl = connection;
+	// the registry hands out a new ID when the client comes back
+	std::atomic<SessionId> id = 0;
+};
+
+static SessionPtr MakeSession() {
+	return std::make_shared<WebSocketSession>([](SerialExecutor::Task task) { task(); });
+}
+
+// the old `sessions` member of `WebSocketServer`
+class LockedMap {
+public:
+	void Add(Client& client) {
+		std::lock_guard<std::mutex> lock(mutex);
+		sessions[client.hdl] = MakeSession();
+	}
+
+	void Remove(Client& client) {
+		std::lock_guard<std::mutex> lock(mutex);
+		sessions.erase(client.hdl);
+	}
+
+	bool Find(Client& client, SessionPtr& session) {
+		std::lock_guard<std::mutex> lock(mutex);
+		try {
+			session = sessions.at(client.hdl);
+			return true;
+		} catch (const std::out_of_range&) {
+			return false;
+		}
+	}
+
+	size_t Broadcast() {
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t count = 0;
+		for (auto& entry : sessions)
+			count += entry.second != nullptr;
+		return count;
+	}
+
+private:
+	std::mutex mutex;
+	std::map<websocketpp::connection_hdl, SessionPtr,
+		 std::owner_less<websocketpp::connection_hdl>>
+	  sessions;
+};
+
+class Registry {
+public:
+	void Add(Client& client) {
+		client.id.store(sessions.Add(client.hdl, MakeSession()), std::memory_order_relaxed);
+	}
+
+	void Remove(Client& client) { sessions.Remove(client.id.load(std::memory_order_relaxed)); }
+
+	bool Find(Client& client, SessionPtr& session) {
+		SessionEntry entry;
+		if (!sessions.Find(client.id.load(std::memory_order_relaxed), entry))
+			return false;
+		session = std::move(entry.session);
+		return true;
+	}
+
+	size_t Broadcast() {
+		size_t count = 0;
+		auto snapshot = sessions.Load();
+		for (auto& entry : *snapshot)
+			count += entry.session != nullptr;
+		return count;
+	}
+
+private:
+	SessionRegistry sessions;
+};
+
+// keeps the broadcast walks from being optimized out
+static std::atomic<size_t> sink = 0;
+
+// returns the average nanoseconds per operation of one reader
+template<typename Sessions>
+static double RunStep(size_t sessionCount, size_t readers, int seconds, int reconnectsPerSec) {
+	Sessions sessions;
+	// a reader may pick a client the writer just removed, that lookup misses
+	std::vector<Client> clients(sessionCount);
+	for (auto& client : clients)
+		sessions.Add(client);
+
+	std::atomic<bool> running = true;
+	std::atomic<uint64_t> operations = 0;
+	std::atomic<uint64_t> busyNs = 0;
+
+	std::vector<std::thread> threads;
+	for (size_t r = 0; r < readers; r++) {
+		threads.emplace_back([&, r]() {
+			std::minstd_rand random(uint32_t(r + 1));
+			uint64_t count = 0;
+			size_t found = 0;
+			auto startedAt = Clock::now();
+			while (running) {
+				if (++count % kBroadcastEvery == 0) {
+					found += sessions.Broadcast();
+					continue;
+				}
+				SessionPtr session;
+				found += sessions.Find(clients[random() % clients.size()], session);
+			}
+			auto elapsed = Clock::now() - startedAt;
+			operations += count;
+			busyNs += uint64_t(
+			  std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+			sink += found;
+		});
+	}
+
+	// a client drops and comes back as a new session, like a flaky network does
+	auto interval = std::chrono::microseconds(1000000 / std::max(reconnectsPerSec, 1));
+	auto deadline = Clock::now() + std::chrono::seconds(seconds);
+	std::minstd_rand random(7);
+	while (Clock::now() < deadline) {
+		if (reconnectsPerSec) {
+			Client& client = clients[random() % clients.size()];
+			sessions.Remove(client);
+			sessions.Add(client);
+		}
+		std::this_thread::sleep_for(interval);
+	}
+
+	running = false;
+	for (auto& thread : threads)
+		thread.join();
+
+	return double(busyNs) / double(std::max<uint64_t>(operations, 1));
+}
+
+int main(int argc, char** argv) {
+	size_t sessionCount = argc > 1 ? std::max(1, atoi(argv[1])) : 200;
+	int seconds = argc > 2 ? std::max(1, atoi(argv[2])) : 1;
+	int reconnectsPerSec = argc > 3 ? std::max(0, atoi(argv[3])) : 100;
+
+	printf("%zu sessions, %d reconnects/s, a broadcast every %u operations\n", sessionCount,
+	       reconnectsPerSec, kBroadcastEvery);
+	printf("%-8s %16s %16s %10s\n", "readers", "locked map ns", "registry ns", "speedup");
+
+	size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	for (size_t readers = 1; readers <= std::min<size_t>(maxThreads, 16); readers *= 2) {
+		double locked =
+		  RunStep<LockedMap>(sessionCount, readers, seconds, reconnectsPerSec);
+		double registry =
+		  RunStep<Registry>(sessionCount, readers, seconds, reconnectsPerSec);
+		printf("%-8zu %16.1f %16.1f %9.2fx\n", readers, locked, registry,
+		       locked / registry);
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+// What a Unix domain socket listener would save same-host controllers against a loopback TCP
+// listener. The server has no Unix socket listener, the websocketpp asio transport only speaks
+// TCP, so this measures the two transports themselves: a client sends a message and waits for
+// the echo from a thread on the other end, back to back, for a few message sizes.
+//
+//   socket-pingpong [seconds per size, default 2]
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#include <asio.hpp>
+
+typedef std::chrono::steady_clock Clock;
+
+// a request, a state update, a scene list and a screenshot sized message
+static const size_t kMessageSizes[] = {64, 1024, 16 * 1024, 256 * 1024};
+
+struct Result {
+	double roundTripsPerSec = 0.0;
+	double p50Us = 0.0;
+	double p99Us = 0.0;
+};
+
+// `sorted` in nanoseconds, returns microseconds
+static double Percentile(const std::vector<uint32_t>& sorted, double p) {
+	if (sorted.empty())
+		return 0.0;
+	return sorted[std::min(sorted.size() - 1, size_t(p * double(sorted.size())))] / 1000.0;
+}
+
+// `client` and `server` are connected to each other
+template<typename Socket> static Result PingPong(Socket& client, Socket& server, size_t size,
+						  int seconds) {
+	// echoes until the client shuts its side down
+	std::thread echo([&server, size]() {
+		std::vector<char> buffer(size);
+		asio::error_code errorCode;
+		while (!errorCode) {
+			asio::read(server, asio::buffer(buffer), errorCode);
+			if (!errorCode)
+				asio::write(server, asio::buffer(buffer), errorCode);
+		}
+	});
+
+	std::vector<char> message(size, 'x');
+	std::vector<char> answer(size);
+	std::vector<uint32_t> latenciesNs;
+	auto startedAt = Clock::now();
+	auto deadline = startedAt + std::chrono::seconds(seconds);
+	for (auto now = startedAt; now < deadline;) {
+		asio::write(client, asio::buffer(message));
+		asio::read(client, asio::buffer(answer));
+		auto answeredAt = Clock::now();
+		latenciesNs.push_back(uint32_t(
+		  std::chrono::duration_cast<std::chrono::nanoseconds>(answeredAt - now).count()));
+		now = answeredAt;
+	}
+	double elapsed = std::chrono::duration<double>(Clock::now() - startedAt).count();
+
+	asio::error_code errorCode;
+	client.shutdown(Socket::shutdown_send, errorCode);
+	echo.join();
+
+	std::sort(latenciesNs.begin(), latenciesNs.end());
+	Result result;
+	result.roundTripsPerSec = double(latenciesNs.size()) / elapsed;
+	result.p50Us = Percentile(latenciesNs, 0.50);
+	result.p99Us = Percentile(latenciesNs, 0.99);
+	return result;
+}
+
+static Result LoopbackTcp(asio::io_context& io, size_t size, int seconds) {
+	using asio::ip::tcp;
+
+	tcp::acceptor acceptor(io, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	tcp::socket client(io);
+	tcp::socket server(io);
+	client.connect(acceptor.local_endpoint());
+	acceptor.accept(server);
+
+	// what the server sets on every connection
+	client.set_option(tcp::no_delay(true));
+	server.set_option(tcp::no_delay(true));
+	return PingPong(client, server, size, seconds);
+}
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+static Result UnixSocket(asio::io_context& io, size_t size, int seconds) {
+	using asio::local::stream_protocol;
+
+	auto path = (std::filesystem::temp_directory_path() / "socket-pingpong.sock").string();
+	std::filesystem::remove(path);
+
+	stream_protocol::acceptor acceptor(io, stream_protocol::endpoint(path));
+	stream_protocol::socket client(io);
+	stream_protocol::socket server(io);
+	client.connect(stream_protocol::endpoint(path));
+	acceptor.accept(server);
+
+	Result result = PingPong(client, server, size, seconds);
+	std::filesystem::remove(path);
+	return result;
+}
+#endif
+
+static void Print(const char* transport, size_t size, const Result& result) {
+	printf("%-10s %10zu %14.0f %10.1f %10.1f\n", transport, size, result.roundTripsPerSec,
+	       result.p50Us, result.p99Us);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+	int seconds = argc > 1 ? std::max(1, atoi(argv[1])) : 2;
+
+	printf("%-10s %10s %14s %10s %10s\n", "transport", "bytes", "round trips/s", "p50 us",
+	       "p99 us");
+
+	try {
+		asio::io_context io;
+		for (size_t size : kMessageSizes) {
+			Print("tcp", size, LoopbackTcp(io, size, seconds));
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+			Print("unix", size, UnixSocket(io, size, seconds));
+#endif
+		}
+	} catch (const std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,201 @@
+// Handshake latency of the TLS endpoint with and without resumption, from a local client to a
+// running recorder with a certificate set. Every connection completes the WebSocket upgrade so
+// TLS 1.3 tickets, which arrive after the handshake, are in hand before the next one starts.
+// Only the TLS handshake is timed, the TCP connect is reported apart as the network floor.
+//
+//   tls-resume [host, default 127.0.0.1] [port, default 8360] [handshakes, default 200]
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+
+typedef std::chrono::steady_clock Clock;
+typedef asio::ssl::stream<asio::ip::tcp::socket> TlsStream;
+
+// bounds the close_notify exchange, the server may just drop the connection instead
+static constexpr auto kShutdownTimeout = std::chrono::milliseconds(200);
+
+struct Handshake {
+	double connectUs = 0.0;
+	double handshakeUs = 0.0;
+	bool reused = false;
+};
+
+class TlsClient {
+public:
+	TlsClient(const std::string& host, const std::string& port)
+	  : host(host), context(asio::ssl::context::tls_client) {
+		// the recorder usually runs with a self-signed certificate
+		context.set_verify_mode(asio::ssl::verify_none);
+		// the client cache is the session handed back with `SSL_set_session()`
+		SSL_CTX_set_session_cache_mode(context.native_handle(), SSL_SESS_CACHE_CLIENT);
+
+		asio::ip::tcp::resolver resolver(io);
+		endpoints = resolver.resolve(host, port);
+	}
+
+	~TlsClient() {
+		if (session)
+			SSL_SESSION_free(session);
+	}
+
+	// one connection, offering the session of the previous one if `resume` is set
+	bool Connect(bool resume, Handshake& result) {
+		TlsStream stream(io, context);
+		asio::error_code errorCode;
+
+		auto startedAt = Clock::now();
+		asio::connect(stream.lowest_layer(), endpoints, errorCode);
+		if (errorCode) {
+			fprintf(stderr, "connect: %s\n", errorCode.message().c_str());
+			return false;
+		}
+		result.connectUs = Elapsed(startedAt);
+		stream.lowest_layer().set_option(asio::ip::tcp::no_delay(true));
+
+		SSL* ssl = stream.native_handle();
+		SSL_set_tlsext_host_name(ssl, host.c_str());
+		if (resume && session)
+			SSL_set_session(ssl, session);
+
+		startedAt = Clock::now();
+		stream.handshake(asio::ssl::stream_base::client, errorCode);
+		result.handshakeUs = Elapsed(startedAt);
+		if (errorCode) {
+			fprintf(stderr, "handshake: %s\n", errorCode.message().c_str());
+			return false;
+		}
+		result.reused = SSL_session_reused(ssl);
+
+		if (!Upgrade(stream))
+			return false;
+
+		SSL_SESSION* next = SSL_get1_session(ssl);
+		if (next) {
+			if (session)
+				SSL_SESSION_free(session);
+			session = next;
+		}
+
+		// a clean close keeps the session resumable for TLS 1.2 session IDs
+		io.restart();
+		stream.async_shutdown([](const asio::error_code&) {});
+		io.run_for(kShutdownTimeout);
+		stream.lowest_layer().close(errorCode);
+		return true;
+	}
+
+	const char* Version() const { return session ? ProtocolName(session) : "none"; }
+
+private:
+	static double Elapsed(Clock::time_point since) {
+		return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+	}
+
+	static const char* ProtocolName(SSL_SESSION* session) {
+		switch (SSL_SESSION_get_protocol_version(session)) {
+		case TLS1_2_VERSION:
+			return "TLSv1.2";
+		case TLS1_3_VERSION:
+			return "TLSv1.3";
+		default:
+			return "other";
+		}
+	}
+
+	// the answer to the upgrade request is the first record after TLS 1.3 tickets
+	bool Upgrade(TlsStream& stream) {
+		std::string request = "GET / HTTP/1.1\r\nHost: " + host +
+				      "\r\n"
+				      "Upgrade: websocket\r\n"
+				      "Connection: Upgrade\r\n"
+				      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+				      "Sec-WebSocket-Version: 13\r\n\r\n";
+		asio::error_code errorCode;
+		asio::write(stream, asio::buffer(request), errorCode);
+		if (errorCode) {
+			fprintf(stderr, "upgrade: %s\n", errorCode.message().c_str());
+			return false;
+		}
+
+		asio::streambuf answer;
+		asio::read_until(stream, answer, "\r\n\r\n", errorCode);
+		if (errorCode) {
+			fprintf(stderr, "upgrade: %s\n", errorCode.message().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	std::string host;
+	asio::io_context io;
+	asio::ssl::context context;
+	asio::ip::tcp::resolver::results_type endpoints;
+	SSL_SESSION* session = nullptr;
+};
+
+static double Percentile(std::vector<double> values, double p) {
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, size_t(p * double(values.size())));
+	return values[index] / 1000.0;
+}
+
+static double Mean(const std::vector<double>& values) {
+	double sum = 0.0;
+	for (double value : values)
+		sum += value;
+	return values.empty() ? 0.0 : sum / double(values.size()) / 1000.0;
+}
+
+int main(int argc, char** argv) {
+	std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+	std::string port = argc > 2 ? argv[2] : "8360";
+	int count = argc > 3 ? std::max(1, atoi(argv[3])) : 200;
+
+	try {
+		TlsClient client(host, port);
+
+		// warm up the server's context and the first ticket
+		Handshake warmup;
+		if (!client.Connect(false, warmup))
+			return 1;
+
+		printf("%s:%s, %s, %d handshakes per mode\n", host.c_str(), port.c_str(),
+		       client.Version(), count);
+		printf("%-8s %8s %10s %10s %10s %12s\n", "mode", "resumed", "mean ms", "p50 ms",
+		       "p99 ms", "connect p50");
+
+		for (bool resume : {false, true}) {
+			std::vector<double> handshakes;
+			std::vector<double> connects;
+			int resumed = 0;
+			for (int i = 0; i < count; i++) {
+				Handshake result;
+				if (!client.Connect(resume, result))
+					return 1;
+				handshakes.push_back(result.handshakeUs);
+				connects.push_back(result.connectUs);
+				resumed += result.reused;
+			}
+
+			const char* mode = resume ? "resumed" : "full";
+			printf("%-8s %8d %10.3f %10.3f %10.3f %12.3f\n", mode, resumed,
+			       Mean(handshakes), Percentile(handshakes, 0.50),
+			       Percentile(handshakes, 0.99), Percentile(connects, 0.50));
+			fflush(stdout);
+		}
+	} catch (const std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
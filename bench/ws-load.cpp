@@ -0,0 +1,366 @@
+// Load generator for the WebSocket control plane. Connects 1 ~ 500 synthetic clients to a
+// running recorder and has each of them send `Echo` requests back to back, one in flight per
+// client, then reports round-trip percentiles, answered requests per second and the server's
+// resident memory per session.
+//
+//   ws-load [--url ws://127.0.0.1:8359] [--clients 1,10,100,500] [--duration 5]
+//           [--payload 64] [--threads 4]
+//
+// The server throttles every session to `WebSocketRateLimit::messagesPerSecond`, throttled
+// answers are counted apart and left out of the latencies. Disable the limit for numbers of the
+// request path itself.
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+#include <json11.hpp>
+
+typedef websocketpp::client<websocketpp::config::asio_client> Client;
+typedef std::chrono::steady_clock Clock;
+
+// status code of a request the rate limit refused, `RequestStatus::TooManyRequests`
+static constexpr int kTooManyRequests = 206;
+static constexpr auto kConnectTimeout = std::chrono::seconds(10);
+static constexpr auto kDrainTimeout = std::chrono::seconds(2);
+
+struct Options {
+	std::string url = "ws://127.0.0.1:8359";
+	std::vector<size_t> clients = {1, 10, 100, 500};
+	int durationSec = 5;
+	size_t payloadBytes = 64;
+	size_t threads = 4;
+};
+
+// one synthetic client, its handlers run on the connection's strand
+struct LoadSession {
+	websocketpp::connection_hdl hdl;
+	Clock::time_point sentAt;
+	uint64_t nextId = 0;
+	bool inFlight = false;
+	std::vector<uint32_t> latenciesUs;
+	uint64_t throttled = 0;
+};
+
+class LoadGenerator {
+public:
+	explicit LoadGenerator(const Options& options) : options(options) {
+		client.clear_access_channels(websocketpp::log::alevel::all);
+		client.clear_error_channels(websocketpp::log::elevel::all);
+		client.init_asio();
+		client.start_perpetual();
+
+		payload.assign(options.payloadBytes, 'x');
+		for (size_t i = 0; i < options.threads; i++)
+			threads.emplace_back([this]() { client.run(); });
+	}
+
+	~LoadGenerator() {
+		client.stop_perpetual();
+		client.stop();
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	// the session that reads the server's memory, stays connected between the steps
+	bool ConnectControl() {
+		if (!Open(1))
+			return false;
+		control = std::move(sessions.front());
+		sessions.clear();
+		return true;
+	}
+
+	// connect `count` load sessions, false if not all of them opened in time
+	bool Connect(size_t count) { return Open(count); }
+
+	// keep every session busy for the duration, returns the seconds it actually took
+	double Run() {
+		running = true;
+		auto startedAt = Clock::now();
+		for (auto& session : sessions)
+			SendEcho(*session);
+
+		std::this_thread::sleep_for(std::chrono::seconds(options.durationSec));
+		running = false;
+		auto stoppedAt = Clock::now();
+
+		// the answers still in flight are counted, no new requests go out
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait_for(lock, kDrainTimeout, [this]() { return inFlight == 0; });
+		return std::chrono::duration<double>(stoppedAt - startedAt).count();
+	}
+
+	// close the load sessions and wait for the server to confirm
+	void Disconnect() {
+		std::unique_lock<std::mutex> lock(mutex);
+		closed = 0;
+		lock.unlock();
+
+		size_t count = 0;
+		for (auto& session : sessions) {
+			websocketpp::lib::error_code errorCode;
+			client.close(session->hdl, websocketpp::close::status::normal, "",
+				     errorCode);
+			if (!errorCode)
+				count++;
+		}
+
+		lock.lock();
+		changed.wait_for(lock, kDrainTimeout, [this, count]() { return closed >= count; });
+		lock.unlock();
+
+		// late handlers of the closed connections may still reach their session
+		for (auto& session : sessions)
+			retired.push_back(std::move(session));
+		sessions.clear();
+	}
+
+	// resident memory of the server process, read through `GetSessionStats`
+	double ServerResidentBytes() {
+		if (!control)
+			return 0.0;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		statsAnswer = json11::Json();
+		lock.unlock();
+
+		static const std::string request =
+		  R"({"op":6,"d":{"requestType":"GetSessionStats","requestId":"stats"}})";
+		websocketpp::lib::error_code errorCode;
+		client.send(control->hdl, request, websocketpp::frame::opcode::text, errorCode);
+		if (errorCode)
+			return 0.0;
+
+		lock.lock();
+		changed.wait_for(lock, kDrainTimeout, [this]() { return !statsAnswer.is_null(); });
+		return statsAnswer["responseData"]["processResidentBytes"].number_value();
+	}
+
+	const std::vector<std::unique_ptr<LoadSession>>& Sessions() const { return sessions; }
+
+private:
+	bool Open(size_t count) {
+		std::unique_lock<std::mutex> lock(mutex);
+		opened = 0;
+		failed = 0;
+		lock.unlock();
+
+		for (size_t i = 0; i < count; i++)
+			sessions.push_back(std::make_unique<LoadSession>());
+
+		for (auto& session : sessions) {
+			websocketpp::lib::error_code errorCode;
+			Client::connection_ptr conn = client.get_connection(options.url, errorCode);
+			if (errorCode) {
+				fprintf(stderr, "connect: %s\n", errorCode.message().c_str());
+				return false;
+			}
+
+			LoadSession* loadSession = session.get();
+			loadSession->hdl = conn->get_handle();
+			using websocketpp::connection_hdl;
+			conn->set_open_handler([this](connection_hdl) { Signal(opened); });
+			conn->set_fail_handler([this](connection_hdl) { Signal(failed); });
+			conn->set_close_handler([this](connection_hdl) { Signal(closed); });
+			conn->set_message_handler(
+			  [this, loadSession](connection_hdl, Client::message_ptr message) {
+				  OnMessage(*loadSession, message->get_payload());
+			  });
+			client.connect(conn);
+		}
+
+		lock.lock();
+		changed.wait_for(lock, kConnectTimeout,
+				 [this, count]() { return opened + failed == count; });
+		return opened == count;
+	}
+
+	void Signal(size_t& counter) {
+		std::lock_guard<std::mutex> lock(mutex);
+		counter++;
+		changed.notify_all();
+	}
+
+	void SendEcho(LoadSession& session) {
+		std::string message = R"({"op":6,"d":{"requestType":"Echo","requestId":")" +
+				      std::to_string(session.nextId++) +
+				      R"(","requestData":{"payload":")" + payload + R"("}}})";
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			inFlight++;
+		}
+		session.inFlight = true;
+		session.sentAt = Clock::now();
+
+		websocketpp::lib::error_code errorCode;
+		client.send(session.hdl, message, websocketpp::frame::opcode::text, errorCode);
+		if (errorCode)
+			Answered(session);
+	}
+
+	void Answered(LoadSession& session) {
+		session.inFlight = false;
+		std::lock_guard<std::mutex> lock(mutex);
+		inFlight--;
+		changed.notify_all();
+	}
+
+	void OnMessage(LoadSession& session, const std::string& message) {
+		auto receivedAt = Clock::now();
+
+		std::string error;
+		json11::Json json = json11::Json::parse(message, error);
+		// events of the default subscriptions are not answers
+		if (json["op"].int_value() != 7)
+			return;
+
+		const json11::Json& d = json["d"];
+		if (d["requestType"].string_value() == "GetSessionStats") {
+			std::lock_guard<std::mutex> lock(mutex);
+			statsAnswer = d;
+			changed.notify_all();
+			return;
+		}
+		if (!session.inFlight)
+			return;
+
+		auto latency = std::chrono::duration_cast<std::chrono::microseconds>(receivedAt -
+										     session.sentAt);
+		if (d["requestStatus"]["code"].int_value() == kTooManyRequests)
+			session.throttled++;
+		else
+			session.latenciesUs.push_back(uint32_t(latency.count()));
+		Answered(session);
+
+		if (running)
+			SendEcho(session);
+	}
+
+	const Options& options;
+	Client client;
+	std::vector<std::thread> threads;
+	std::string payload;
+	std::unique_ptr<LoadSession> control;
+	std::vector<std::unique_ptr<LoadSession>> sessions;
+	std::vector<std::unique_ptr<LoadSession>> retired;
+	std::atomic<bool> running = false;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	size_t opened = 0;
+	size_t failed = 0;
+	size_t closed = 0;
+	size_t inFlight = 0;
+	json11::Json statsAnswer;
+};
+
+static double Percentile(const std::vector<uint32_t>& sorted, double p) {
+	if (sorted.empty())
+		return 0.0;
+	size_t index = std::min(sorted.size() - 1, size_t(p * double(sorted.size())));
+	return sorted[index] / 1000.0;
+}
+
+static std::vector<size_t> ParseCounts(const char* list) {
+	std::vector<size_t> counts;
+	for (const char* pos = list; *pos;) {
+		char* next = nullptr;
+		unsigned long count = strtoul(pos, &next, 10);
+		if (next == pos)
+			break;
+		if (count)
+			counts.push_back(std::min<size_t>(count, 500));
+		pos = *next == ',' ? next + 1 : next;
+	}
+	return counts;
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const char* name = argv[i];
+		const char* value = argv[i + 1];
+		if (strcmp(name, "--url") == 0)
+			options.url = value;
+		else if (strcmp(name, "--clients") == 0)
+			options.clients = ParseCounts(value);
+		else if (strcmp(name, "--duration") == 0)
+			options.durationSec = std::max(1, atoi(value));
+		else if (strcmp(name, "--payload") == 0)
+			options.payloadBytes = strtoul(value, nullptr, 10);
+		else if (strcmp(name, "--threads") == 0)
+			options.threads = std::max(1, atoi(value));
+		else
+			return false;
+	}
+	return argc % 2 == 1 && !options.clients.empty();
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		fprintf(stderr,
+			"usage: %s [--url ws://127.0.0.1:8359] [--clients 1,10,100,500] "
+			"[--duration 5] [--payload 64] [--threads 4]\n",
+			argv[0]);
+		return 2;
+	}
+
+	printf("%-8s %12s %9s %9s %9s %10s %12s\n", "clients", "requests/s", "p50 ms", "p99 ms",
+	       "p999 ms", "throttled", "KiB/session");
+
+	LoadGenerator generator(options);
+	if (!generator.ConnectControl()) {
+		fprintf(stderr, "can not connect to %s\n", options.url.c_str());
+		return 1;
+	}
+
+	for (size_t count : options.clients) {
+		// the server's footprint before and after the load sessions connected
+		double residentBefore = generator.ServerResidentBytes();
+		if (!generator.Connect(count)) {
+			fprintf(stderr, "%zu clients: not every session connected\n", count);
+			generator.Disconnect();
+			return 1;
+		}
+		double residentAfter = generator.ServerResidentBytes();
+
+		double seconds = generator.Run();
+
+		std::vector<uint32_t> latencies;
+		uint64_t throttled = 0;
+		for (auto& session : generator.Sessions()) {
+			latencies.insert(latencies.end(), session->latenciesUs.begin(),
+					 session->latenciesUs.end());
+			throttled += session->throttled;
+		}
+		std::sort(latencies.begin(), latencies.end());
+		generator.Disconnect();
+
+		double perSession = 0.0;
+		if (residentAfter > residentBefore)
+			perSession = (residentAfter - residentBefore) / double(count) / 1024.0;
+		printf("%-8zu %12.0f %9.3f %9.3f %9.3f %10llu %12.1f\n", count,
+		       double(latencies.size()) / seconds, Percentile(latencies, 0.50),
+		       Percentile(latencies, 0.99), Percentile(latencies, 0.999),
+		       (unsigned long long)throttled, perSession);
+		fflush(stdout);
+
+		// let the server release the closed sessions before the next step
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	}
+
+	return 0;
+}
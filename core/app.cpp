@@ -13,6 +13,7 @@
 #include <string>
 #include <sstream>
 #include <mutex>
+#include <condition_variable>
 #include <numeric>
 #include <functional>
 #include <fstream>
@@ -38,6 +39,16 @@ static std::string lastCrashLogFile;
 static bool log_verbose = false;
 static bool unfiltered_log = false;
 
+static std::atomic<core::LogListener> log_listener = nullptr;
+static void* log_listener_param = nullptr;
+// guards the param and the count of listener calls in flight, `SetLogListener()` waits for
+// those to drain
+static std::mutex log_listener_mutex;
+static std::condition_variable log_listener_idle;
+static int log_listener_calls = 0;
+// lines logged by the listener itself are not handed back to it
+static thread_local bool log_listener_running = false;
+
 namespace core {
 
 static void delete_oldest_file(bool has_prefix, const char* location) {
@@ -582,6 +593,24 @@ static void LogStringChunk(std::fstream& logFile, char* str, int log_level) {
 	LogString(logFile, timeString.c_str(), str, log_level);
 }
 
+static void CallLogListener(int log_level, const char* str) {
+	std::unique_lock<std::mutex> lock(log_listener_mutex);
+	LogListener listener = log_listener.load(std::memory_order_relaxed);
+	if (!listener)
+		return;
+	void* param = log_listener_param;
+	log_listener_calls++;
+	lock.unlock();
+
+	log_listener_running = true;
+	listener(log_level, str, param);
+	log_listener_running = false;
+
+	lock.lock();
+	if (--log_listener_calls == 0)
+		log_listener_idle.notify_all();
+}
+
 static void do_log(int log_level, const char* msg, va_list args, void* param) {
 	std::fstream& logFile = *static_cast<std::fstream*>(param);
 	char str[4096];
@@ -593,6 +622,9 @@ static void do_log(int log_level, const char* msg, va_list args, void* param) {
 
 	vsnprintf(str, sizeof(str), msg, args);
 
+	if (!log_listener_running && log_listener.load(std::memory_order_relaxed))
+		CallLogListener(log_level, str);
+
 #ifdef _WIN32
 	if (IsDebuggerPresent()) {
 		int wNum = MultiByteToWideChar(CP_UTF8, 0, str, -1, NULL, 0);
@@ -633,6 +665,17 @@ static void do_log(int log_level, const char* msg, va_list args, void* param) {
 #endif
 }
 
+void SetLogListener(LogListener listener, void* param) {
+	std::unique_lock<std::mutex> lock(log_listener_mutex);
+	log_listener.store(listener, std::memory_order_relaxed);
+	log_listener_param = param;
+
+	// calls of the previous listener may still run on other threads, a call on this thread
+	// (the listener replacing itself) can't finish before we return
+	int own = log_listener_running ? 1 : 0;
+	log_listener_idle.wait(lock, [own]() { return log_listener_calls <= own; });
+}
+
 static void create_log_file(std::fstream& logFile) {
 	std::stringstream dst;
 
@@ -1056,6 +1099,8 @@ int App::Run(int argc, char* argv[], UIApplication* application) {
 void App::Quit() {
 	obs_hotkey_set_callback_routing_func(nullptr, nullptr);
 
+	// flush while the sources still exist
+	projectSaver.reset();
 	sceneSourceManager.reset();
 	service = nullptr;
 	outputManager.reset();
@@ -1283,6 +1328,8 @@ bool App::InitGlobalConfigDefaults() {
 
 	config_set_default_string(globalConfig, "General", "HotkeyFocusType",
 				  "NeverDisableHotkeys");
+	config_set_default_uint(globalConfig, "General", "ProjectSaveDelayMs",
+				ProjectSaver::kDefaultDelayMs);
 
 	config_set_default_bool(globalConfig, "BasicWindow", "VerticalVolControl", false);
 
@@ -1438,6 +1485,11 @@ bool App::OBSInit() {
 
 	// register source signal handler
 	sceneSourceManager = std::make_unique<SceneSourceManager>();
+	projectSaver = std::make_unique<ProjectSaver>(
+	  [this]() { return SnapshotProject(); },
+	  [this](std::function<void()> task) { application->PostToUIThread(std::move(task)); });
+	projectSaver->SetDelay(
+	  (uint32_t)config_get_uint(globalConfig, "General", "ProjectSaveDelayMs"));
 
 	struct obs_module_failure_info mfi;
 
@@ -1699,6 +1751,9 @@ bool App::InitBasicConfigDefaults() {
 	config_set_default_string(basicConfig, "Output", "FilenameFormatting",
 				  "%CCYY-%MM-%DD %hh-%mm-%ss");
 
+	config_set_default_bool(basicConfig, "Output", "RecStandby", false);
+	config_set_default_bool(basicConfig, "Output", "ShareStreamEncoder", false);
+
 	config_set_default_bool(basicConfig, "Output", "DelayEnable", false);
 	config_set_default_uint(basicConfig, "Output", "DelaySec", 20);
 	config_set_default_bool(basicConfig, "Output", "DelayPreserve", true);
@@ -1819,12 +1874,20 @@ void App::ResetOutputs() {
 }
 
 int App::ResetVideo(int width, int height) {
-	if (outputManager != nullptr) {
-		if (outputManager->Active()) {
-			return OBS_VIDEO_CURRENTLY_ACTIVE;
-		}
-	}
+	if (outputManager == nullptr)
+		return ResetVideoInfo(width, height);
 
+	if (outputManager->Active())
+		return OBS_VIDEO_CURRENTLY_ACTIVE;
+
+	// standby encodes the current video, it comes back whether the reset worked or not
+	outputManager->StopRecordingStandby();
+	int ret = ResetVideoInfo(width, height);
+	outputManager->RestoreRecordingStandby();
+	return ret;
+}
+
+int App::ResetVideoInfo(int width, int height) {
 	ProfileScope("MainWindow::ResetVideo");
 
 	struct obs_video_info ovi;
@@ -2312,6 +2375,10 @@ void App::LoadData(obs_data_t* data, const char* file) {
 }
 
 void App::ClearSceneData() {
+	// the pending changes belong to the collection that is going away
+	if (projectSaver)
+		projectSaver->Flush();
+
 	disableSaving++;
 
 	for (int i = 0; i < MAX_CHANNELS; i++) obs_set_output_source(i, nullptr);
@@ -2399,29 +2466,33 @@ void App::CreateDefaultScene(bool firstStart) {
 }
 
 void App::SaveProjectNow() {
-	if (disableSaving)
+	if (disableSaving || !projectSaver)
 		return;
 
-	projectChanged = true;
-	SaveProjectDeferred();
+	projectSaver->MarkDirty();
+	projectSaver->Flush();
 }
 
 void App::SaveProject() {
-	if (disableSaving)
+	if (disableSaving || !projectSaver)
 		return;
 
-	projectChanged = true;
-	SaveProjectDeferred();
+	projectSaver->MarkDirty();
 }
 
 void App::SaveProjectDeferred() {
-	if (disableSaving)
+	if (disableSaving || !projectSaver)
 		return;
 
-	if (!projectChanged)
-		return;
+	projectSaver->Flush();
+}
 
-	projectChanged = false;
+ProjectSaver::WriteFunc App::SnapshotProject() {
+	// a collection is being cleared or loaded, try again once that is over
+	if (os_atomic_load_long(&disableSaving)) {
+		projectSaver->MarkDirty();
+		return nullptr;
+	}
 
 	const char* sceneCollection =
 	  config_get_string(GetGlobalConfig(), "Basic", "SceneCollectionFile");
@@ -2431,21 +2502,26 @@ void App::SaveProjectDeferred() {
 	int ret;
 
 	if (!sceneCollection)
-		return;
+		return nullptr;
 
 	ret =
 	  snprintf(fileName, sizeof(fileName), "obs-studio/basic/scenes/%s.json", sceneCollection);
 	if (ret <= 0)
-		return;
+		return nullptr;
 
 	ret = GetConfigPath(savePath, sizeof(savePath), fileName);
 	if (ret <= 0)
-		return;
+		return nullptr;
 
-	Save(savePath);
+	OBSData saveData = GenerateProjectData();
+	std::string file = savePath;
+	return [saveData, file]() {
+		if (!obs_data_save_json_safe(saveData, file.c_str(), "tmp", "bak"))
+			blog(LOG_ERROR, "Could not save scene data to %s", file.c_str());
+	};
 }
 
-void App::Save(const char* file) {
+OBSData App::GenerateProjectData() {
 	OBSScene scene = GetCurrentScene();
 	OBSSource curProgramScene = OBSGetStrongRef(programScene);
 	if (!curProgramScene)
@@ -2464,8 +2540,7 @@ void App::Save(const char* file) {
 		obs_data_set_obj(saveData, "modules", moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
-		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	return saveData.Get();
 }
 
 void App::DeferSaveBegin() {
@@ -2562,6 +2637,13 @@ void App::SetCurrentScene(OBSSource scene, bool force) {
 
 				if (api)
 					api->on_event(OBS_FRONTEND_EVENT_SCENE_CHANGED);
+
+				uint8_t stack[128];
+				calldata_t cd;
+				calldata_init_fixed(&cd, stack, sizeof(stack));
+				calldata_set_ptr(&cd, "source", source);
+				signal_handler_signal(obs_get_signal_handler(),
+						      "current_scene_changed", &cd);
 				break;
 			}
 		}
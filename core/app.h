@@ -5,6 +5,7 @@
 #include "utils.h"
 #include "ui.h"
 #include "scene-source.h"
+#include "project-saver.h"
 
 #define VERSION "0.0.1"
 
@@ -37,6 +38,12 @@ struct LaunchOptions {
 	std::string opt_starting_scene;
 };
 
+// Receives every log line on the thread that logged it. Only one listener at a time, pass
+// nullptr to remove it; no listener costs a single atomic load per line. Returns once calls
+// of the previous listener on other threads are done, so its param can be freed afterwards.
+typedef void (*LogListener)(int level, const char* message, void* param);
+void SetLogListener(LogListener listener, void* param);
+
 /// forward declares
 struct BasicOutputHandler;
 class OutputManager;
@@ -72,8 +79,13 @@ public:
 	bool IsVcamEnabled() const { return vcamEnabled; }
 
 	obs_service_t* GetService();
+	// replace the stream service, `SaveService()` writes it to the profile
+	void SetService(obs_service_t* service);
+	void SaveService();
 
+	// flag the scene collection as changed, `ProjectSaver` writes it shortly after
 	void SaveProject();
+	// write pending changes now
 	void SaveProjectDeferred();
 	void DeferSaveBegin();
 	void DeferSaveEnd();
@@ -103,12 +115,12 @@ private:
 
 	std::unique_ptr<OutputManager> outputManager = nullptr;
 	std::unique_ptr<SceneSourceManager> sceneSourceManager = nullptr;
+	std::unique_ptr<ProjectSaver> projectSaver = nullptr;
 
 	volatile bool previewProgramMode = false;
 	bool libobs_initialized = false;
 	bool loaded = false;
 	long disableSaving = 1;
-	bool projectChanged = false;
 	bool previewEnabled = true;
 	bool closing = false;
 	bool clearingFailed = false;
@@ -165,6 +177,7 @@ private:
 	void DeleteProfile(const std::string& profileName);
 
 	// audio & video
+	int ResetVideoInfo(int width, int height);
 	void GetFPSCommon(uint32_t& num, uint32_t& den) const;
 	void GetFPSInteger(uint32_t& num, uint32_t& den) const;
 	void GetFPSFraction(uint32_t& num, uint32_t& den) const;
@@ -174,8 +187,6 @@ private:
 	const char* GetRenderModule() const;
 
 	// service
-	void SetService(obs_service_t* service);
-	void SaveService();
 	bool LoadService();
 	bool InitService();
 
@@ -187,7 +198,6 @@ private:
 	void SetTransition(OBSSource transition);
 	void TransitionToScene(OBSSource source);
 
-	void Save(const char* file);
 	void LoadData(obs_data_t* data, const char* file);
 	void Load(const char* file);
 
@@ -199,6 +209,10 @@ private:
 			      int channel);
 
 	void SaveProjectNow();
+	// snapshot the current collection on the UI thread, the returned write runs on the
+	// `ProjectSaver` thread
+	ProjectSaver::WriteFunc SnapshotProject();
+	OBSData GenerateProjectData();
 };
 } // namespace core
 
@@ -30,6 +30,8 @@ target_sources(
   ${CMAKE_CURRENT_SOURCE_DIR}/core/preview.h
   ${CMAKE_CURRENT_SOURCE_DIR}/core/scene-source.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/core/scene-source.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/core/project-saver.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/core/project-saver.h
   ${CMAKE_CURRENT_SOURCE_DIR}/core/source-preview.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/core/source-preview.h
   ${CMAKE_CURRENT_SOURCE_DIR}/core/defines.h
@@ -1,8 +1,11 @@
 #include "output.h"
 
+#include <cerrno>
+#include <atomic>
 #include <algorithm>
 
 #include "util/threading.h"
+#include "util/platform.h"
 
 #include "audio-encoders.h"
 #include "app.h"
@@ -39,7 +42,7 @@ static void OBSStreamStopping(void* data, calldata_t* params) {
 
 	int sec = (int)obs_output_get_active_delay(obj);
 	if (sec == 0) {
-		output->callback->OnStreamStopped("", 0);
+		output->callback->OnStreamStopping();
 	} else {
 		output->callback->OnStreamDelayStopping(sec);
 	}
@@ -96,6 +99,23 @@ static void OBSRecordStopping(void* data, calldata_t* /* params */) {
 	output->callback->OnRecordingStopping();
 }
 
+static void OBSRecordPaused(void* data, calldata_t* /* params */) {
+	core::BasicOutputHandler* output = static_cast<core::BasicOutputHandler*>(data);
+	os_atomic_set_bool(&recording_paused, true);
+	output->callback->OnRecordingPaused();
+}
+
+static void OBSRecordResumed(void* data, calldata_t* /* params */) {
+	core::BasicOutputHandler* output = static_cast<core::BasicOutputHandler*>(data);
+	os_atomic_set_bool(&recording_paused, false);
+	output->callback->OnRecordingResumed();
+}
+
+static void OBSStandbyStopped(void* data, calldata_t* /* params */) {
+	core::BasicOutputHandler* output = static_cast<core::BasicOutputHandler*>(data);
+	os_event_signal(output->standbyStopped);
+}
+
 static void OBSRecordFileChanged(void* data, calldata_t* params) {
 	core::BasicOutputHandler* output = static_cast<core::BasicOutputHandler*>(data);
 	const char* next_file = calldata_string(params, "next_file");
@@ -200,20 +220,115 @@ static bool OutputPathValid() {
 ////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////
 
-OutputManager::OutputManager() {}
+// Emitted on the libobs core signal handler by the recording and streaming callbacks below, so
+// listeners that are not the output callback can follow the outputs without polling
+static const char* recordingSignals[] = {
+  "void recording_started()",
+  "void recording_stopping()",
+  "void recording_stopped(string error, int code)",
+  "void recording_file_changed(string path)",
+  "void recording_paused()",
+  "void recording_resumed()",
+  nullptr,
+};
+
+static const char* streamingSignals[] = {
+  "void streaming_delay_starting(int seconds)",
+  "void streaming_started()",
+  "void streaming_stopping(int delay)",
+  "void streaming_stopped(string error, int code)",
+  nullptr,
+};
+
+static void SignalOutput(const char* signal, calldata_t* cd) {
+	signal_handler_signal(obs_get_signal_handler(), signal, cd);
+}
 
-OutputManager::~OutputManager() {}
+OutputManager::OutputManager() {
+	static bool registered = false;
+	if (!registered) {
+		signal_handler_add_array(obs_get_signal_handler(), recordingSignals);
+		signal_handler_add_array(obs_get_signal_handler(), streamingSignals);
+		registered = true;
+	}
+}
+
+OutputManager::~OutputManager() {
+	if (recordingCpuInfo)
+		os_cpu_usage_info_destroy(recordingCpuInfo);
+}
 
 void OutputManager::SetOutputHandler(std::unique_ptr<BasicOutputHandler> handler) {
 	outputHandler = std::move(handler);
+	RefreshRecordingSettings();
 }
 
 void OutputManager::Update() {
 	if (outputHandler) {
 		outputHandler->Update();
+		RefreshRecordingSettings();
 	}
 }
 
+void OutputManager::RefreshRecordingSettings() {
+	if (!outputHandler)
+		return;
+
+	outputHandler->recordingPrepared = false;
+
+	// standby holds the encoders busy, they take new settings only while it is down
+	bool standby = config_get_bool(CoreApp->GetBasicConfig(), "Output", "RecStandby");
+	if (!outputHandler->StopStandby()) {
+		blog(LOG_WARNING, "[OutputManager::RefreshRecordingSettings] Standby did not stop, "
+				  "the settings are read again on the next start");
+		return;
+	}
+
+	// a running output or packet tap keeps the encoders as they are, the next start takes the
+	// slow path
+	if (!outputHandler->EncodersBusy())
+		outputHandler->PrepareRecording();
+	else if (!outputHandler->Active())
+		blog(LOG_INFO, "[OutputManager::RefreshRecordingSettings] Encoders are held by the "
+			       "packet tap, new settings apply when it stops");
+
+	if (standby)
+		outputHandler->StartStandby();
+}
+
+void OutputManager::SetRecordingStandby(bool enabled) {
+	auto& profile = CoreApp->GetBasicConfig();
+	config_set_bool(profile, "Output", "RecStandby", enabled);
+	config_save_safe(profile, "tmp", nullptr);
+
+	if (!outputHandler)
+		return;
+
+	if (enabled)
+		RefreshRecordingSettings();
+	else
+		outputHandler->StopStandby();
+}
+
+void OutputManager::StopRecordingStandby() {
+	if (outputHandler)
+		outputHandler->StopStandby();
+}
+
+void OutputManager::RestoreRecordingStandby() {
+	if (outputHandler && config_get_bool(CoreApp->GetBasicConfig(), "Output", "RecStandby"))
+		outputHandler->StartStandby();
+}
+
+bool OutputManager::RecordingStandbyActive() {
+	return outputHandler && outputHandler->StandbyActive();
+}
+
+void OutputManager::GetStandbyCost(StandbyCost& cost) {
+	if (outputHandler)
+		outputHandler->GetStandbyCost(cost);
+}
+
 bool OutputManager::Active() {
 	if (outputHandler) {
 		return outputHandler->Active();
@@ -221,20 +336,220 @@ bool OutputManager::Active() {
 	return false;
 }
 
-void OutputManager::SetStreamAddress(const std::string& addr, const std::string& username,
-				     const std::string& passwd) {}
+bool OutputManager::RecordingActive() {
+	if (outputHandler) {
+		return outputHandler->RecordingActive();
+	}
+	return false;
+}
+
+static void GetOutputStats(obs_output_t* output, OutputStats& stats) {
+	if (!output)
+		return;
+
+	stats.active = obs_output_active(output);
+	stats.totalFrames = (uint64_t)obs_output_get_total_frames(output);
+	stats.droppedFrames = (uint64_t)obs_output_get_frames_dropped(output);
+	stats.totalBytes = obs_output_get_total_bytes(output);
+	stats.congestion = obs_output_get_congestion(output);
+}
+
+void OutputManager::GetStatistics(OutputStatistics& stats) {
+	stats.activeFps = obs_get_active_fps();
+	stats.averageFrameTimeMs = (double)obs_get_average_frame_time_ns() / 1000000.0;
+	stats.renderTotalFrames = obs_get_total_frames();
+	stats.renderLaggedFrames = obs_get_lagged_frames();
+
+	video_t* video = obs_get_video();
+	stats.outputTotalFrames = video_output_get_total_frames(video);
+	stats.outputSkippedFrames = video_output_get_skipped_frames(video);
+
+	if (outputHandler) {
+		GetOutputStats(outputHandler->fileOutput, stats.fileOutput);
+		GetOutputStats(outputHandler->streamOutput, stats.streamOutput);
+		GetOutputStats(outputHandler->replayBuffer, stats.replayBuffer);
+
+		obs_encoder_t* recordEncoder = obs_output_get_video_encoder(outputHandler->fileOutput);
+		stats.sharedEncoder = recordEncoder && stats.fileOutput.active &&
+				      stats.streamOutput.active &&
+				      recordEncoder ==
+					obs_output_get_video_encoder(outputHandler->streamOutput);
+	}
+}
+
+bool OutputManager::StartPacketTap(EncodedPacketTap* tap) {
+	if (outputHandler) {
+		return outputHandler->StartPacketTap(tap);
+	}
+	return false;
+}
+
+void OutputManager::StopPacketTap() {
+	if (outputHandler) {
+		outputHandler->StopPacketTap();
+	}
+}
+
+obs_encoder_t* OutputManager::PacketTapAudioEncoder() {
+	if (outputHandler) {
+		return outputHandler->PacketTapAudioEncoder();
+	}
+	return nullptr;
+}
+
+// rtmp://host/app/key -> server `rtmp://host/app` and key `key`, the other protocols carry
+// everything in the server address
+static void SplitStreamAddress(const std::string& addr, std::string& server, std::string& key) {
+	server = addr;
+	key.clear();
+
+	const char* str = addr.c_str();
+	if (astrcmpi_n(str, "rtmp://", 7) != 0 && astrcmpi_n(str, "rtmps://", 8) != 0)
+		return;
+
+	size_t pathStart = addr.find('/', addr.find("://") + 3);
+	size_t keyStart = addr.rfind('/');
+	if (pathStart == std::string::npos || keyStart == pathStart)
+		return;
+
+	server = addr.substr(0, keyStart);
+	key = addr.substr(keyStart + 1);
+}
+
+bool OutputManager::SetStreamAddress(const std::string& addr, const std::string& username,
+				     const std::string& passwd) {
+	if (addr.empty()) {
+		blog(LOG_ERROR, "Can not set stream address to empty");
+		return false;
+	}
+
+	if (StreamingActive()) {
+		blog(LOG_ERROR, "Can not change the stream address while streaming");
+		return false;
+	}
+
+	std::string server, key;
+	SplitStreamAddress(addr, server, key);
+
+	OBSDataAutoRelease settings = obs_data_create();
+	obs_data_set_string(settings, "server", server.c_str());
+	obs_data_set_string(settings, "key", key.c_str());
+	obs_data_set_bool(settings, "use_auth", !username.empty());
+	obs_data_set_string(settings, "username", username.c_str());
+	obs_data_set_string(settings, "password", passwd.c_str());
+
+	obs_service_t* service =
+	  obs_service_create("rtmp_custom", "default_service", settings, nullptr);
+	if (!service) {
+		blog(LOG_ERROR, "Failed to create the stream service");
+		return false;
+	}
+
+	CoreApp->SetService(service);
+	obs_service_release(service);
+	CoreApp->SaveService();
+
+	// the address may carry credentials, e.g. an SRT passphrase
+	blog(LOG_INFO, "[OutputManager::SetStreamAddress] Streaming over %s",
+	     obs_service_get_protocol(service));
+
+	// the streaming encoders pick up the limits of the new service
+	if (outputHandler && !outputHandler->EncodersBusy())
+		Update();
+	return true;
+}
+
+bool OutputManager::StartStreaming() {
+	uint64_t requestedAt = os_gettime_ns();
+
+	if (!outputHandler)
+		return false;
+
+	if (outputHandler->StreamingActive()) {
+		blog(LOG_ERROR, "streaming already start");
+		return false;
+	}
+
+	obs_service_t* service = CoreApp->GetService();
+	if (!outputHandler->SetupStreaming(service)) {
+		blog(LOG_ERROR, "failed to set up streaming");
+		return false;
+	}
+
+	if (!outputHandler->StartStreaming(service)) {
+		blog(LOG_ERROR, "failed to start streaming: %s", outputHandler->lastError.c_str());
+		return false;
+	}
+
+	// with a shared encoder a running recording hands its encoder over as it is
+	bool shared = outputHandler->RecordingUsesStreamEncoder();
+	blog(LOG_INFO, "[OutputManager::StartStreaming] Output started in %.2f ms (%s)",
+	     (os_gettime_ns() - requestedAt) / 1000000.0,
+	     shared && outputHandler->RecordingActive() ? "recording encoder" : "own encoder");
+
+	CoreApp->SaveProject();
+	return true;
+}
+
+void OutputManager::StopStreaming() {
+	CoreApp->SaveProject();
+
+	if (StreamingActive())
+		outputHandler->StopStreaming();
+}
+
+bool OutputManager::StreamingActive() {
+	return outputHandler && outputHandler->StreamingActive();
+}
+
+bool OutputManager::SetSharedEncoder(bool shared) {
+	// rebuilding the handler would pull the encoders from under a packet tap as well
+	if (Active() || (outputHandler && outputHandler->PacketTapActive())) {
+		blog(LOG_ERROR, "Can not change the shared encoder while an output is active");
+		return false;
+	}
+
+	auto& profile = CoreApp->GetBasicConfig();
+	config_set_bool(profile, "Output", "ShareStreamEncoder", shared);
+	config_save_safe(profile, "tmp", nullptr);
+
+	ResetOutputHandler();
+
+	if (shared && !SharedEncoder())
+		blog(LOG_WARNING, "[OutputManager::SetSharedEncoder] The recording settings need "
+				  "an encoder of their own (lossless or FFmpeg output)");
+	return true;
+}
+
+bool OutputManager::SharedEncoder() {
+	return outputHandler && outputHandler->RecordingUsesStreamEncoder();
+}
 
-void OutputManager::StartStreaming() {}
+void OutputManager::ResetOutputHandler() {
+	const char* mode = config_get_string(CoreApp->GetBasicConfig(), "Output", "Mode");
 
-void OutputManager::StopStreaming() {}
+	// the old encoders go first, two sets of them never exist at once
+	outputHandler.reset();
+
+	std::unique_ptr<BasicOutputHandler> handler;
+	if (astrcmpi(mode, "Advanced") == 0)
+		handler.reset(CreateAdvancedOutputHandler(this));
+	else
+		handler.reset(CreateSimpleOutputHandler(this));
+	SetOutputHandler(std::move(handler));
+}
 
 bool OutputManager::StartRecording() {
+	uint64_t requestedAt = os_gettime_ns();
+
 	if (outputHandler->RecordingActive()) {
 		blog(LOG_ERROR, "recording already start");
 		return false;
 	}
 
-	if (!OutputPathValid()) {
+	// prepared settings were validated when they were read
+	bool prepared = outputHandler->recordingPrepared;
+	if (!prepared && !OutputPathValid()) {
 		blog(LOG_ERROR, "recording stopped because of bad output path");
 		return false;
 	}
@@ -245,19 +560,38 @@ bool OutputManager::StartRecording() {
     return false;
   }*/
 
-	// save the project
-	CoreApp->SaveProject();
-
+	recordingRequestedAt = requestedAt;
 	if (!outputHandler->StartRecording()) {
+		recordingRequestedAt = 0;
 		blog(LOG_ERROR, "failed to start recording");
 		return false;
 	}
 
+	blog(LOG_INFO, "[OutputManager::StartRecording] Output started in %.2f ms (%s)",
+	     (os_gettime_ns() - requestedAt) / 1000000.0, prepared ? "prepared" : "cold");
+
+	// save the project once the recording runs, the write happens on the saver thread
+	CoreApp->SaveProject();
+
 	return true;
 }
 
 bool OutputManager::PauseRecording() {
-	return false;
+	if (!outputHandler || !outputHandler->RecordingActive() || outputHandler->RecordingPaused())
+		return false;
+
+	return outputHandler->PauseRecording(true);
+}
+
+bool OutputManager::ResumeRecording() {
+	if (!outputHandler || !outputHandler->RecordingPaused())
+		return false;
+
+	return outputHandler->PauseRecording(false);
+}
+
+bool OutputManager::RecordingPaused() {
+	return outputHandler && outputHandler->RecordingPaused();
 }
 
 void OutputManager::StopRecording() {
@@ -301,16 +635,16 @@ void OutputManager::StopVirtualCam() {
 	outputHandler->StopVirtualCam();
 }
 
-void OutputManager::SetCurrentRecordingFolder(const std::string& path) {
+bool OutputManager::SetCurrentRecordingFolder(const std::string& path) {
 	if (path.empty()) {
 		blog(LOG_ERROR, "Can not set recording folder to empty path");
-		return;
+		return false;
 	}
 
 	std::string lastSavedPath = GetCurrentOutputPath();
 	if (lastSavedPath == path) {
 		blog(LOG_ERROR, "The output path is already there!");
-		return;
+		return false;
 	}
 
 	auto& profile = CoreApp->GetBasicConfig();
@@ -318,6 +652,8 @@ void OutputManager::SetCurrentRecordingFolder(const std::string& path) {
 	config_set_string(profile, "SimpleOutput", "FilePath", path.c_str());
 
 	config_save_safe(profile, "tmp", nullptr);
+	RefreshRecordingSettings();
+	return true;
 }
 
 void OutputManager::SaveOutputSettings() {
@@ -325,10 +661,10 @@ void OutputManager::SaveOutputSettings() {
 	config_save_safe(CoreApp->GetGlobalConfig(), "tmp", nullptr);
 }
 
-void OutputManager::ChangeOutputSize(uint32_t width, uint32_t height) {
+bool OutputManager::ChangeOutputSize(uint32_t width, uint32_t height) {
 	if (width <= 32 || height <= 32) {
 		blog(LOG_ERROR, "Can not set output size less than 32");
-		return;
+		return false;
 	}
 
 	auto& profile = CoreApp->GetBasicConfig();
@@ -338,12 +674,14 @@ void OutputManager::ChangeOutputSize(uint32_t width, uint32_t height) {
 	config_set_uint(profile, "Video", "OutputCY", height);
 
 	config_save_safe(profile, "tmp", nullptr);
+	RefreshRecordingSettings();
+	return true;
 }
 
-void OutputManager::ChangeVideoContainer(const std::string& container) {
+bool OutputManager::ChangeVideoContainer(const std::string& container) {
 	if (container.empty()) {
 		blog(LOG_ERROR, "Can not set video container to empty");
-		return;
+		return false;
 	}
 
 	std::map<std::string, std::string> formatMap = {
@@ -361,7 +699,7 @@ void OutputManager::ChangeVideoContainer(const std::string& container) {
 		  LOG_ERROR,
 		  "Can not set video container to %s, not support, consider: {MP4, MKV, FLV, MOV, TS} instead",
 		  container.c_str());
-		return;
+		return false;
 	}
 
 	auto& profile = CoreApp->GetBasicConfig();
@@ -369,12 +707,14 @@ void OutputManager::ChangeVideoContainer(const std::string& container) {
 	config_set_string(profile, "SimpleOutput", "RecFormat2", container.c_str());
 
 	config_save_safe(profile, "tmp", nullptr);
+	RefreshRecordingSettings();
+	return true;
 }
 
-void OutputManager::ChangeVideoEncoder(const std::string& encoder) {
+bool OutputManager::ChangeVideoEncoder(const std::string& encoder) {
 	if (encoder.empty()) {
 		blog(LOG_ERROR, "Can not set video encoder to empty");
-		return;
+		return false;
 	}
 
 	std::map<std::string, std::string> encoderMap = {
@@ -388,7 +728,7 @@ void OutputManager::ChangeVideoEncoder(const std::string& encoder) {
 		  LOG_ERROR,
 		  "Can not set video encoder to %s, not support, consider: {CPU-x264, GPU-QSV, GPU-NVENC} instead",
 		  encoder.c_str());
-		return;
+		return false;
 	}
 
 	auto& profile = CoreApp->GetBasicConfig();
@@ -396,12 +736,14 @@ void OutputManager::ChangeVideoEncoder(const std::string& encoder) {
 	config_set_string(profile, "SimpleOutput", "StreamEncoder", encoderMap[encoder].c_str());
 
 	config_save_safe(profile, "tmp", nullptr);
+	RefreshRecordingSettings();
+	return true;
 }
 
-void OutputManager::ChangeVideoEncodeQuality(const std::string& quality) {
+bool OutputManager::ChangeVideoEncodeQuality(const std::string& quality) {
 	if (quality.empty()) {
 		blog(LOG_ERROR, "Can not set video encoder quality to empty");
-		return;
+		return false;
 	}
 
 	std::map<std::string, std::string> qualityMap = {
@@ -416,13 +758,15 @@ void OutputManager::ChangeVideoEncodeQuality(const std::string& quality) {
 		  LOG_ERROR,
 		  "Can not set video encoder quality to %s, not support, consider: {High, Lossy, Lossless} instead",
 		  quality.c_str());
-		return;
+		return false;
 	}
 
 	auto& profile = CoreApp->GetBasicConfig();
 	config_set_string(profile, "SimpleOutput", "RecQuality", qualityMap[quality].c_str());
 
 	config_save_safe(profile, "tmp", nullptr);
+	RefreshRecordingSettings();
+	return true;
 }
 
 void OutputManager::UpdateVideoRecodeBitrate(uint32_t bitrate) {
@@ -430,23 +774,124 @@ void OutputManager::UpdateVideoRecodeBitrate(uint32_t bitrate) {
 	config_set_uint(profile, "SimpleOutput", "VBitrate", bitrate);
 
 	config_save_safe(profile, "tmp", nullptr);
+	RefreshRecordingSettings();
+}
+
+void OutputManager::OnStreamDelayStarting(int seconds) {
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_int(&cd, "seconds", seconds);
+	SignalOutput("streaming_delay_starting", &cd);
+}
+
+void OutputManager::OnStreamDelayStopping(int seconds) {
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_int(&cd, "delay", seconds);
+	SignalOutput("streaming_stopping", &cd);
+}
+
+void OutputManager::OnStreamStarted() {
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	SignalOutput("streaming_started", &cd);
+}
+
+void OutputManager::OnStreamStopping() {
+	OnStreamDelayStopping(0);
 }
 
-void OutputManager::OnStreamDelayStarting(int seconds) {}
+void OutputManager::OnStreamStopped(std::string error, int code) {
+	calldata_t cd = {0};
+	calldata_set_string(&cd, "error", error.c_str());
+	calldata_set_int(&cd, "code", code);
+	SignalOutput("streaming_stopped", &cd);
+	calldata_free(&cd);
+}
 
-void OutputManager::OnStreamDelayStopping(int seconds) {}
+void OutputManager::OnRecordingStarted() {
+	uint64_t requestedAt = recordingRequestedAt.exchange(0);
+	if (requestedAt)
+		blog(LOG_INFO,
+		     "[OutputManager::OnRecordingStarted] Recording started %.2f ms after the request",
+		     (os_gettime_ns() - requestedAt) / 1000000.0);
 
-void OutputManager::OnStreamStarted() {}
+	{
+		std::lock_guard<std::mutex> lock(recordingCpuMutex);
+		if (recordingCpuInfo)
+			os_cpu_usage_info_destroy(recordingCpuInfo);
+		recordingCpuInfo = os_cpu_usage_info_start();
+	}
 
-void OutputManager::OnStreamStopped(std::string error, int code) {}
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	SignalOutput("recording_started", &cd);
+}
 
-void OutputManager::OnRecordingStarted() {}
+void OutputManager::OnRecordingStopping() {
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	SignalOutput("recording_stopping", &cd);
+}
 
-void OutputManager::OnRecordingStopping() {}
+void OutputManager::OnRecordingStopped(std::string error, int code) {
+	{
+		std::lock_guard<std::mutex> lock(recordingCpuMutex);
+		if (recordingCpuInfo) {
+			os_cpu_usage_info_destroy(recordingCpuInfo);
+			recordingCpuInfo = nullptr;
+		}
+	}
 
-void OutputManager::OnRecordingStopped(std::string error, int code) {}
+	calldata_t cd = {0};
+	calldata_set_string(&cd, "error", error.c_str());
+	calldata_set_int(&cd, "code", code);
+	SignalOutput("recording_stopped", &cd);
+	calldata_free(&cd);
+}
 
-void OutputManager::OnRecordingFileChanged(std::string path) {}
+void OutputManager::OnRecordingFileChanged(std::string path) {
+	calldata_t cd = {0};
+	calldata_set_string(&cd, "path", path.c_str());
+	SignalOutput("recording_file_changed", &cd);
+	calldata_free(&cd);
+}
+
+void OutputManager::OnRecordingPaused() {
+	{
+		// usage since the start or the previous resume
+		std::lock_guard<std::mutex> lock(recordingCpuMutex);
+		if (recordingCpuInfo)
+			recordingCpuUsage = os_cpu_usage_info_query(recordingCpuInfo);
+	}
+
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	SignalOutput("recording_paused", &cd);
+}
+
+void OutputManager::OnRecordingResumed() {
+	{
+		std::lock_guard<std::mutex> lock(recordingCpuMutex);
+		if (recordingCpuInfo) {
+			double pausedCpuUsage = os_cpu_usage_info_query(recordingCpuInfo);
+			blog(LOG_INFO,
+			     "[OutputManager::OnRecordingResumed] Process CPU %.1f%% while paused, %.1f%% while recording, %.1f%% saved",
+			     pausedCpuUsage, recordingCpuUsage, recordingCpuUsage - pausedCpuUsage);
+		}
+	}
+
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	SignalOutput("recording_resumed", &cd);
+}
 
 void OutputManager::OnReplayBufferStarted() {}
 
@@ -592,7 +1037,7 @@ bool BasicOutputHandler::StartVirtualCam() {
 	}
 
 	obs_output_set_media(virtualCam, virtualCamVideo, obs_get_audio());
-	if (!Active())
+	if (!EncodersBusy())
 		SetupOutputs();
 
 	bool success = obs_output_start(virtualCam);
@@ -645,6 +1090,277 @@ void BasicOutputHandler::DestroyVirtualCameraScene() {
 
 /* ------------------------------------------------------------------------ */
 
+// An encoded output that writes nothing, it hands every packet to an `EncodedPacketTap`
+struct PacketTapOutput {
+	obs_output_t* output;
+	std::atomic<EncodedPacketTap*> tap = nullptr;
+};
+
+static const char* PacketTapGetName(void*) {
+	return "Packet Tap";
+}
+
+static void* PacketTapCreate(obs_data_t*, obs_output_t* output) {
+	return new PacketTapOutput{output};
+}
+
+static void PacketTapDestroy(void* data) {
+	delete static_cast<PacketTapOutput*>(data);
+}
+
+static bool PacketTapStart(void* data) {
+	auto tap = static_cast<PacketTapOutput*>(data);
+	if (!obs_output_can_begin_data_capture(tap->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(tap->output, 0))
+		return false;
+
+	return obs_output_begin_data_capture(tap->output, 0);
+}
+
+static void PacketTapStop(void* data, uint64_t) {
+	auto tap = static_cast<PacketTapOutput*>(data);
+	obs_output_end_data_capture(tap->output);
+}
+
+static void PacketTapPacket(void* data, struct encoder_packet* packet) {
+	auto tap = static_cast<PacketTapOutput*>(data);
+	EncodedPacketTap* receiver = tap->tap;
+	if (packet && receiver)
+		receiver->OnEncodedPacket(packet);
+}
+
+static void RegisterPacketTapOutput() {
+	static bool registered = false;
+	if (registered)
+		return;
+
+	obs_output_info info = {};
+	info.id = "packet_tap_output";
+	info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+	info.get_name = PacketTapGetName;
+	info.create = PacketTapCreate;
+	info.destroy = PacketTapDestroy;
+	info.start = PacketTapStart;
+	info.stop = PacketTapStop;
+	info.encoded_packet = PacketTapPacket;
+	obs_register_output(&info);
+
+	registered = true;
+}
+
+bool BasicOutputHandler::StartPacketTap(EncodedPacketTap* tap) {
+	if (PacketTapActive())
+		StopPacketTap();
+
+	if (!EncodersBusy())
+		SetupOutputs();
+
+	// share the encoders the recording uses, file outputs driven by ffmpeg have none
+	obs_encoder_t* videoEncoder = obs_output_get_video_encoder(fileOutput);
+	obs_encoder_t* audioEncoder = obs_output_get_audio_encoder(fileOutput, 0);
+	if (!videoEncoder || !audioEncoder) {
+		blog(LOG_WARNING, "[BasicOutputHandler::StartPacketTap] Recording has no encoders");
+		return false;
+	}
+
+	if (!packetTap) {
+		RegisterPacketTapOutput();
+		packetTap = obs_output_create("packet_tap_output", "packet_tap", nullptr, nullptr);
+		if (!packetTap)
+			return false;
+	}
+
+	static_cast<PacketTapOutput*>(obs_obj_get_data(packetTap))->tap = tap;
+	obs_output_set_video_encoder(packetTap, videoEncoder);
+	obs_output_set_audio_encoder(packetTap, audioEncoder, 0);
+
+	if (!obs_output_start(packetTap)) {
+		const char* error = obs_output_get_last_error(packetTap);
+		blog(LOG_WARNING, "[BasicOutputHandler::StartPacketTap] Failed to start: %s",
+		     error ? error : "unknown error");
+		static_cast<PacketTapOutput*>(obs_obj_get_data(packetTap))->tap = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void BasicOutputHandler::StopPacketTap() {
+	if (!packetTap)
+		return;
+
+	obs_output_stop(packetTap);
+	static_cast<PacketTapOutput*>(obs_obj_get_data(packetTap))->tap = nullptr;
+}
+
+bool BasicOutputHandler::PacketTapActive() const {
+	return packetTap && obs_output_active(packetTap);
+}
+
+obs_encoder_t* BasicOutputHandler::PacketTapAudioEncoder() const {
+	return packetTap ? obs_output_get_audio_encoder(packetTap, 0) : nullptr;
+}
+
+bool BasicOutputHandler::PauseRecording(bool pause) {
+	if (!fileOutput || !obs_output_active(fileOutput))
+		return false;
+
+	// pausing the shared encoders would freeze the stream as well
+	if (pause && RecordingUsesStreamEncoder()) {
+		blog(LOG_WARNING, "[BasicOutputHandler::PauseRecording] The recording shares the "
+				  "streaming encoders and can not pause");
+		return false;
+	}
+
+	if (!obs_output_can_pause(fileOutput)) {
+		blog(LOG_WARNING, "[BasicOutputHandler::PauseRecording] Output `%s` can not pause",
+		     obs_output_get_id(fileOutput));
+		return false;
+	}
+
+	// the `pause`/`unpause` signals of the output report the change
+	return obs_output_pause(fileOutput, pause);
+}
+
+bool BasicOutputHandler::RecordingPaused() const {
+	return fileOutput && obs_output_paused(fileOutput);
+}
+
+BasicOutputHandler::~BasicOutputHandler() {
+	StopStandby();
+
+	standbyStop.Disconnect();
+	if (standbyStopped)
+		os_event_destroy(standbyStopped);
+}
+
+bool BasicOutputHandler::StartStandby() {
+	if (StandbyActive())
+		return true;
+
+	if (!EncodersBusy())
+		SetupOutputs();
+
+	obs_encoder_t* videoEncoder = obs_output_get_video_encoder(fileOutput);
+	obs_encoder_t* audioEncoder = obs_output_get_audio_encoder(fileOutput, 0);
+	if (!videoEncoder || !audioEncoder) {
+		blog(LOG_WARNING, "[BasicOutputHandler::StartStandby] Recording has no encoders");
+		return false;
+	}
+
+	// a recording joining the running encoders starts at their next keyframe, the stream
+	// keeps the interval its service asks for
+	if (!obs_encoder_active(videoEncoder) && !RecordingUsesStreamEncoder()) {
+		OBSDataAutoRelease current = obs_encoder_get_settings(videoEncoder);
+		int64_t keyint = obs_data_get_int(current, "keyint_sec");
+		if ((keyint <= 0 || keyint > kStandbyKeyintSec) && !standbyKeyintEncoder) {
+			standbyKeyintEncoder = videoEncoder;
+			standbyKeyintWasSet = obs_data_has_user_value(current, "keyint_sec");
+			standbyKeyint = keyint;
+
+			OBSDataAutoRelease settings = obs_data_create();
+			obs_data_set_int(settings, "keyint_sec", kStandbyKeyintSec);
+			obs_encoder_update(videoEncoder, settings);
+		}
+	}
+
+	if (!standbyOutput) {
+		RegisterPacketTapOutput();
+		standbyOutput =
+		  obs_output_create("packet_tap_output", "recording_standby", nullptr, nullptr);
+		if (!standbyOutput) {
+			RestoreStandbyKeyint();
+			return false;
+		}
+
+		if (!standbyStopped)
+			os_event_init(&standbyStopped, OS_EVENT_TYPE_MANUAL);
+		standbyStop.Connect(obs_output_get_signal_handler(standbyOutput), "stop",
+				    OBSStandbyStopped, this);
+	}
+
+	obs_output_set_video_encoder(standbyOutput, videoEncoder);
+	obs_output_set_audio_encoder(standbyOutput, audioEncoder, 0);
+
+	standbyResidentBase = os_get_proc_resident_size();
+	uint64_t startedAt = os_gettime_ns();
+	// the tap stays null, every packet is dropped
+	if (!obs_output_start(standbyOutput)) {
+		const char* error = obs_output_get_last_error(standbyOutput);
+		blog(LOG_WARNING, "[BasicOutputHandler::StartStandby] Failed to start: %s",
+		     error ? error : "unknown error");
+		RestoreStandbyKeyint();
+		return false;
+	}
+
+	standbyStartedAt = os_gettime_ns();
+	if (!standbyCpuInfo)
+		standbyCpuInfo = os_cpu_usage_info_start();
+
+	blog(LOG_INFO, "[BasicOutputHandler::StartStandby] Encoders ready in %.2f ms",
+	     (standbyStartedAt - startedAt) / 1000000.0);
+	return true;
+}
+
+bool BasicOutputHandler::StopStandby() {
+	if (standbyOutput && obs_output_active(standbyOutput)) {
+		os_event_reset(standbyStopped);
+		obs_output_stop(standbyOutput);
+
+		// libobs releases the encoders on a thread of its own, callers go on to
+		// reconfigure them
+		if (os_event_timedwait(standbyStopped, kStandbyStopTimeoutMs) == ETIMEDOUT &&
+		    obs_output_active(standbyOutput)) {
+			blog(LOG_WARNING,
+			     "[BasicOutputHandler::StopStandby] Encoders still held after %lu ms",
+			     kStandbyStopTimeoutMs);
+			return false;
+		}
+	}
+
+	RestoreStandbyKeyint();
+
+	standbyStartedAt = 0;
+	if (standbyCpuInfo) {
+		os_cpu_usage_info_destroy(standbyCpuInfo);
+		standbyCpuInfo = nullptr;
+	}
+	return true;
+}
+
+void BasicOutputHandler::RestoreStandbyKeyint() {
+	if (!standbyKeyintEncoder)
+		return;
+
+	// the settings object is the encoder's own, it reads the interval on its next start
+	OBSDataAutoRelease settings = obs_encoder_get_settings(standbyKeyintEncoder);
+	if (standbyKeyintWasSet)
+		obs_data_set_int(settings, "keyint_sec", standbyKeyint);
+	else
+		obs_data_unset_user_value(settings, "keyint_sec");
+	standbyKeyintEncoder = nullptr;
+}
+
+bool BasicOutputHandler::StandbyActive() const {
+	return standbyOutput && obs_output_active(standbyOutput);
+}
+
+void BasicOutputHandler::GetStandbyCost(StandbyCost& cost) {
+	cost.active = StandbyActive();
+	if (!cost.active)
+		return;
+
+	cost.durationMs = (os_gettime_ns() - standbyStartedAt) / 1000000;
+	cost.encodedFrames = (uint64_t)obs_output_get_total_frames(standbyOutput);
+	cost.residentDeltaBytes =
+	  (int64_t)os_get_proc_resident_size() - (int64_t)standbyResidentBase;
+	if (standbyCpuInfo)
+		cost.processCpuUsage = os_cpu_usage_info_query(standbyCpuInfo);
+}
+
+/* ------------------------------------------------------------------------ */
+
 struct SimpleOutput : BasicOutputHandler {
 	OBSEncoder audioStreaming;
 	OBSEncoder videoStreaming;
@@ -660,6 +1376,22 @@ struct SimpleOutput : BasicOutputHandler {
 	bool ffmpegOutput = false;
 	bool lowCPUx264 = false;
 
+	// the profile keys a recording start needs, read by `LoadRecordingSettings()`
+	struct RecordingSettings {
+		std::string path;
+		std::string format;
+		std::string quality;
+		std::string mux;
+		std::string filenameFormat;
+		std::string rbPrefix;
+		std::string rbSuffix;
+		bool noSpace = false;
+		bool overwriteIfExists = false;
+		int64_t rbTime = 0;
+		int64_t rbSize = 0;
+		int64_t tracks = 0;
+	} recordingSettings;
+
 	SimpleOutput(OutputCallback* callback);
 
 	int CalcCRF(int crf);
@@ -686,6 +1418,7 @@ struct SimpleOutput : BasicOutputHandler {
 
 	void LoadStreamingPreset_Lossy(const char* encoder);
 
+	void LoadRecordingSettings();
 	void UpdateRecording();
 	bool ConfigureRecording(bool useReplayBuffer);
 
@@ -694,6 +1427,8 @@ struct SimpleOutput : BasicOutputHandler {
 	virtual bool SetupStreaming(obs_service_t* service) override;
 	virtual bool StartStreaming(obs_service_t* service) override;
 	virtual bool StartRecording() override;
+	virtual bool PrepareRecording() override;
+	virtual bool RecordingUsesStreamEncoder() const override;
 	virtual bool StartReplayBuffer() override;
 	virtual void StopStreaming(bool force) override;
 	virtual void StopRecording(bool force) override;
@@ -770,9 +1505,17 @@ const char* get_simple_output_encoder(const char* encoder) {
 	return "obs_x264";
 }
 
-void SimpleOutput::LoadRecordingPreset() {
+// the recording quality in effect, `Output/ShareStreamEncoder` turns every quality that the
+// streaming encoders can produce into `Stream`
+static const char* SimpleRecordingQuality() {
 	const char* quality =
 	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecQuality");
+	bool share = config_get_bool(CoreApp->GetBasicConfig(), "Output", "ShareStreamEncoder");
+	return share && strcmp(quality, "Lossless") != 0 ? "Stream" : quality;
+}
+
+void SimpleOutput::LoadRecordingPreset() {
+	const char* quality = SimpleRecordingQuality();
 	const char* encoder =
 	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecEncoder");
 	const char* audio_encoder =
@@ -907,6 +1650,10 @@ SimpleOutput::SimpleOutput(OutputCallback* callback) : BasicOutputHandler(callba
 			      this);
 	recordStopping.Connect(obs_output_get_signal_handler(fileOutput), "stopping",
 			       OBSRecordStopping, this);
+	recordPaused.Connect(obs_output_get_signal_handler(fileOutput), "pause", OBSRecordPaused,
+			     this);
+	recordResumed.Connect(obs_output_get_signal_handler(fileOutput), "unpause",
+			      OBSRecordResumed, this);
 }
 
 int SimpleOutput::GetAudioBitrate() const {
@@ -1013,8 +1760,7 @@ void SimpleOutput::UpdateRecordingAudioSettings() {
 	auto tracks = config_get_int(CoreApp->GetBasicConfig(), "SimpleOutput", "RecTracks");
 	const char* recFormat =
 	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecFormat2");
-	const char* quality =
-	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecQuality");
+	const char* quality = SimpleRecordingQuality();
 	bool flv = strcmp(recFormat, "flv") == 0;
 
 	if (flv || strcmp(quality, "Stream") == 0) {
@@ -1227,7 +1973,7 @@ const char* FindAudioEncoderFromCodec(const char* type) {
 }
 
 bool SimpleOutput::SetupStreaming(obs_service_t* service) {
-	if (!Active())
+	if (!EncodersBusy())
 		SetupOutputs();
 
 	/* --------------------- */
@@ -1364,15 +2110,36 @@ bool SimpleOutput::StartStreaming(obs_service_t* service) {
 	return false;
 }
 
+static std::string ConfigString(const char* section, const char* name) {
+	const char* value = config_get_string(CoreApp->GetBasicConfig(), section, name);
+	return value ? value : "";
+}
+
+void SimpleOutput::LoadRecordingSettings() {
+	ConfigFile& config = CoreApp->GetBasicConfig();
+	RecordingSettings& settings = recordingSettings;
+
+	settings.path = ConfigString("SimpleOutput", "FilePath");
+	settings.format = ConfigString("SimpleOutput", "RecFormat2");
+	settings.quality = SimpleRecordingQuality();
+	settings.mux = ConfigString("SimpleOutput", "MuxerCustom");
+	settings.filenameFormat = ConfigString("Output", "FilenameFormatting");
+	settings.rbPrefix = ConfigString("SimpleOutput", "RecRBPrefix");
+	settings.rbSuffix = ConfigString("SimpleOutput", "RecRBSuffix");
+	settings.noSpace = config_get_bool(config, "SimpleOutput", "FileNameWithoutSpace");
+	settings.overwriteIfExists = config_get_bool(config, "Output", "OverwriteIfExists");
+	settings.rbTime = config_get_int(config, "SimpleOutput", "RecRBTime");
+	settings.rbSize = config_get_int(config, "SimpleOutput", "RecRBSize");
+	settings.tracks = config_get_int(config, "SimpleOutput", "RecTracks");
+}
+
 void SimpleOutput::UpdateRecording() {
-	const char* recFormat =
-	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecFormat2");
+	const char* recFormat = recordingSettings.format.c_str();
 	bool flv = strcmp(recFormat, "flv") == 0;
-	auto tracks = config_get_int(CoreApp->GetBasicConfig(), "SimpleOutput", "RecTracks");
+	auto tracks = recordingSettings.tracks;
 	int idx = 0;
 	int idx2 = 0;
-	const char* quality =
-	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecQuality");
+	const char* quality = recordingSettings.quality.c_str();
 
 	if (replayBufferActive || recordingActive)
 		return;
@@ -1384,7 +2151,7 @@ void SimpleOutput::UpdateRecording() {
 		Update();
 	}
 
-	if (!Active())
+	if (!EncodersBusy())
 		SetupOutputs();
 
 	if (!ffmpegOutput) {
@@ -1418,24 +2185,19 @@ void SimpleOutput::UpdateRecording() {
 }
 
 bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer) {
-	const char* path = config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "FilePath");
-	const char* format =
-	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecFormat2");
-	const char* mux =
-	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "MuxerCustom");
-	bool noSpace =
-	  config_get_bool(CoreApp->GetBasicConfig(), "SimpleOutput", "FileNameWithoutSpace");
-	const char* filenameFormat =
-	  config_get_string(CoreApp->GetBasicConfig(), "Output", "FilenameFormatting");
-	bool overwriteIfExists =
-	  config_get_bool(CoreApp->GetBasicConfig(), "Output", "OverwriteIfExists");
-	const char* rbPrefix =
-	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecRBPrefix");
-	const char* rbSuffix =
-	  config_get_string(CoreApp->GetBasicConfig(), "SimpleOutput", "RecRBSuffix");
-	auto rbTime = config_get_int(CoreApp->GetBasicConfig(), "SimpleOutput", "RecRBTime");
-	auto rbSize = config_get_int(CoreApp->GetBasicConfig(), "SimpleOutput", "RecRBSize");
-	auto tracks = config_get_int(CoreApp->GetBasicConfig(), "SimpleOutput", "RecTracks");
+	const RecordingSettings& settings = recordingSettings;
+	const char* path = settings.path.c_str();
+	const char* format = settings.format.c_str();
+	// unset means no custom muxer settings
+	const char* mux = settings.mux.empty() ? nullptr : settings.mux.c_str();
+	bool noSpace = settings.noSpace;
+	const char* filenameFormat = settings.filenameFormat.c_str();
+	bool overwriteIfExists = settings.overwriteIfExists;
+	const char* rbPrefix = settings.rbPrefix.c_str();
+	const char* rbSuffix = settings.rbSuffix.c_str();
+	auto rbTime = settings.rbTime;
+	auto rbSize = settings.rbSize;
+	auto tracks = settings.tracks;
 
 	bool is_fragmented = strncmp(format, "fragmented", 10) == 0;
 	bool is_lossless = videoQuality == "Lossless";
@@ -1485,8 +2247,29 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer) {
 	return true;
 }
 
-bool SimpleOutput::StartRecording() {
+bool SimpleOutput::PrepareRecording() {
+	if (replayBufferActive || recordingActive)
+		return false;
+
+	LoadRecordingSettings();
+	if (recordingSettings.path.empty()) {
+		blog(LOG_WARNING, "[SimpleOutput::PrepareRecording] No recording path configured");
+		return false;
+	}
+
 	UpdateRecording();
+	// with the `Stream` quality the recording shares the streaming encoders, whose settings
+	// follow the stream and have to be applied on every start
+	recordingPrepared = usingRecordingPreset;
+	return recordingPrepared;
+}
+
+bool SimpleOutput::StartRecording() {
+	// the prepared settings are already on the encoders
+	if (!recordingPrepared) {
+		LoadRecordingSettings();
+		UpdateRecording();
+	}
 	if (!ConfigureRecording(false))
 		return false;
 	if (!obs_output_start(fileOutput)) {
@@ -1501,6 +2284,7 @@ bool SimpleOutput::StartRecording() {
 }
 
 bool SimpleOutput::StartReplayBuffer() {
+	LoadRecordingSettings();
 	UpdateRecording();
 	if (!ConfigureRecording(true))
 		return false;
@@ -1537,6 +2321,11 @@ bool SimpleOutput::StreamingActive() const {
 	return obs_output_active(streamOutput);
 }
 
+bool SimpleOutput::RecordingUsesStreamEncoder() const {
+	// the `Stream` quality reuses the streaming encoders instead of loading a preset
+	return !usingRecordingPreset;
+}
+
 bool SimpleOutput::RecordingActive() const {
 	return obs_output_active(fileOutput);
 }
@@ -1583,6 +2372,7 @@ struct AdvancedOutput : BasicOutputHandler {
 	virtual void StopRecording(bool force) override;
 	virtual void StopReplayBuffer(bool force) override;
 	virtual bool StreamingActive() const override;
+	virtual bool RecordingUsesStreamEncoder() const override;
 	virtual bool RecordingActive() const override;
 	virtual bool ReplayBufferActive() const override;
 };
@@ -1645,7 +2435,9 @@ AdvancedOutput::AdvancedOutput(OutputCallback* cb) : BasicOutputHandler(cb) {
 	ffmpegOutput = astrcmpi(recType, "FFmpeg") == 0;
 	ffmpegRecording = ffmpegOutput &&
 			  config_get_bool(CoreApp->GetBasicConfig(), "AdvOut", "FFOutputToFile");
-	useStreamEncoder = astrcmpi(recordEncoder, "none") == 0;
+	useStreamEncoder = astrcmpi(recordEncoder, "none") == 0 ||
+			   (!ffmpegOutput && config_get_bool(CoreApp->GetBasicConfig(), "Output",
+							     "ShareStreamEncoder"));
 	useStreamAudioEncoder = astrcmpi(recAudioEncoder, "none") == 0;
 
 	OBSData streamEncSettings = GetDataFromJsonFile("streamEncoder.json");
@@ -1754,6 +2546,10 @@ AdvancedOutput::AdvancedOutput(OutputCallback* cb) : BasicOutputHandler(cb) {
 			      this);
 	recordStopping.Connect(obs_output_get_signal_handler(fileOutput), "stopping",
 			       OBSRecordStopping, this);
+	recordPaused.Connect(obs_output_get_signal_handler(fileOutput), "pause", OBSRecordPaused,
+			     this);
+	recordResumed.Connect(obs_output_get_signal_handler(fileOutput), "unpause",
+			      OBSRecordResumed, this);
 	recordFileChanged.Connect(obs_output_get_signal_handler(fileOutput), "file_changed",
 				  OBSRecordFileChanged, this);
 }
@@ -2105,7 +2901,7 @@ bool AdvancedOutput::SetupStreaming(obs_service_t* service) {
 
 	UpdateAudioSettings();
 
-	if (!Active())
+	if (!EncodersBusy())
 		SetupOutputs();
 
 	/* --------------------- */
@@ -2227,7 +3023,7 @@ bool AdvancedOutput::StartRecording() {
 
 	UpdateAudioSettings();
 
-	if (!Active())
+	if (!EncodersBusy())
 		SetupOutputs();
 
 	if (!ffmpegOutput || ffmpegRecording) {
@@ -2306,7 +3102,7 @@ bool AdvancedOutput::StartReplayBuffer() {
 
 	UpdateAudioSettings();
 
-	if (!Active())
+	if (!EncodersBusy())
 		SetupOutputs();
 
 	if (!ffmpegOutput || ffmpegRecording) {
@@ -2379,6 +3175,10 @@ bool AdvancedOutput::StreamingActive() const {
 	return obs_output_active(streamOutput);
 }
 
+bool AdvancedOutput::RecordingUsesStreamEncoder() const {
+	return useStreamEncoder && !ffmpegOutput;
+}
+
 bool AdvancedOutput::RecordingActive() const {
 	return obs_output_active(fileOutput);
 }
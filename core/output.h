@@ -2,8 +2,12 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <atomic>
 
 #include <obs.hpp>
+#include <util/platform.h>
+#include <util/threading.h>
 
 namespace core {
 
@@ -15,6 +19,7 @@ public:
 	virtual void OnStreamDelayStarting(int seconds) = 0;
 	virtual void OnStreamDelayStopping(int seconds) = 0;
 	virtual void OnStreamStarted() = 0;
+	virtual void OnStreamStopping() = 0;
 	virtual void OnStreamStopped(std::string error, int code) = 0;
 
 	// recording
@@ -22,6 +27,8 @@ public:
 	virtual void OnRecordingStopping() = 0;
 	virtual void OnRecordingStopped(std::string error, int code) = 0;
 	virtual void OnRecordingFileChanged(std::string path) = 0;
+	virtual void OnRecordingPaused() = 0;
+	virtual void OnRecordingResumed() = 0;
 
 	// replay
 	virtual void OnReplayBufferStarted() = 0;
@@ -35,16 +42,70 @@ public:
 	virtual void OnVirtualCamStopped(std::string error, int code) = 0;
 };
 
+// Receives the packets of the recording encoders, see `BasicOutputHandler::StartPacketTap()`
+class EncodedPacketTap {
+public:
+	virtual ~EncodedPacketTap() {}
+
+	// called on the libobs output thread, `packet` is only valid during the call
+	virtual void OnEncodedPacket(struct encoder_packet* packet) = 0;
+};
+
+// counters of one output, all cumulative since the output was created
+struct OutputStats {
+	bool active = false;
+	uint64_t totalFrames = 0;
+	uint64_t droppedFrames = 0;
+	uint64_t totalBytes = 0;
+	// 0.0 ~ 1.0, only meaningful for network outputs
+	float congestion = 0.0f;
+};
+
+struct OutputStatistics {
+	double activeFps = 0.0;
+	double averageFrameTimeMs = 0.0;
+	// frames rendered and those missed because rendering took too long
+	uint32_t renderTotalFrames = 0;
+	uint32_t renderLaggedFrames = 0;
+	// frames of the main video output and those skipped due to encoding lag
+	uint32_t outputTotalFrames = 0;
+	uint32_t outputSkippedFrames = 0;
+	// the recording and the stream are fed by one video encoder
+	bool sharedEncoder = false;
+
+	OutputStats fileOutput;
+	OutputStats streamOutput;
+	OutputStats replayBuffer;
+};
+
+// what keeping the recording encoders hot costs, see `OutputManager::SetRecordingStandby()`
+struct StandbyCost {
+	bool active = false;
+	uint64_t durationMs = 0;
+	// frames encoded since standby started, they are only kept while a recording runs
+	uint64_t encodedFrames = 0;
+	// resident memory of the process now minus right before standby started
+	int64_t residentDeltaBytes = 0;
+	// CPU usage of the whole process since the previous query, 0.0 ~ 100.0
+	double processCpuUsage = 0.0;
+};
+
 struct BasicOutputHandler {
 	OBSOutputAutoRelease fileOutput;
 	OBSOutputAutoRelease streamOutput;
 	OBSOutputAutoRelease replayBuffer;
 	OBSOutputAutoRelease virtualCam;
+	OBSOutputAutoRelease packetTap;
+	OBSOutputAutoRelease standbyOutput;
+	// set by the `stop` signal of `standbyOutput`
+	os_event_t* standbyStopped = nullptr;
 	bool streamingActive = false;
 	bool recordingActive = false;
 	bool delayActive = false;
 	bool replayBufferActive = false;
 	bool virtualCamActive = false;
+	// set by `PrepareRecording()`, cleared whenever the recording settings may have changed
+	bool recordingPrepared = false;
 	OutputCallback* callback = nullptr;
 
 	obs_view_t* virtualCamView = nullptr;
@@ -70,16 +131,29 @@ struct BasicOutputHandler {
 	OBSSignal streamStopping;
 	OBSSignal recordStopping;
 	OBSSignal recordFileChanged;
+	OBSSignal recordPaused;
+	OBSSignal recordResumed;
 	OBSSignal replayBufferStopping;
 	OBSSignal replayBufferSaved;
+	OBSSignal standbyStop;
 
 	inline BasicOutputHandler(OutputCallback* callback);
 
-	virtual ~BasicOutputHandler(){};
+	virtual ~BasicOutputHandler();
 
 	virtual bool SetupStreaming(obs_service_t* service) = 0;
 	virtual bool StartStreaming(obs_service_t* service) = 0;
 	virtual bool StartRecording() = 0;
+	// Pause or resume the file output. libobs drops the frames of the paused encoders before
+	// they are encoded and shifts the later timestamps, so the file continues seamlessly.
+	virtual bool PauseRecording(bool pause);
+	bool RecordingPaused() const;
+	// Read and validate the recording settings and apply them to the encoders ahead of time,
+	// a prepared `StartRecording()` then only names the file and starts the output. Handlers
+	// without a fast path return false and read the settings on every start.
+	virtual bool PrepareRecording() { return false; }
+	// whether the recording runs on the streaming encoders instead of encoders of its own
+	virtual bool RecordingUsesStreamEncoder() const { return false; }
 	virtual bool StartReplayBuffer() { return false; }
 	virtual bool StartVirtualCam();
 	virtual void StopStreaming(bool force = false) = 0;
@@ -98,13 +172,52 @@ struct BasicOutputHandler {
 	virtual void DestroyVirtualCamView();
 	virtual void DestroyVirtualCameraScene();
 
+	// forward the packets of the recording video encoder and its first audio track to `tap`,
+	// the encoders are started if the recording is not running
+	bool StartPacketTap(EncodedPacketTap* tap);
+	void StopPacketTap();
+	bool PacketTapActive() const;
+	// the audio encoder the tap was started with, null without a tap
+	obs_encoder_t* PacketTapAudioEncoder() const;
+
+	// Hot standby: keep the recording encoders initialized and encoding into an output that
+	// writes nothing, a recording or replay buffer started meanwhile joins them at their next
+	// keyframe instead of initializing them. The keyframe interval is capped at
+	// `kStandbyKeyintSec` to bound that wait and restored when standby stops, an encoder the
+	// stream shares keeps the interval of its service.
+	static constexpr int kStandbyKeyintSec = 1;
+	// how long `StopStandby()` waits for libobs to release the encoders
+	static constexpr unsigned long kStandbyStopTimeoutMs = 1000;
+	bool StartStandby();
+	// false if the encoders are still held once the timeout is over
+	bool StopStandby();
+	bool StandbyActive() const;
+	void GetStandbyCost(StandbyCost& cost);
+
+	// outputs the user started
 	inline bool Active() const {
 		return streamingActive || recordingActive || delayActive || replayBufferActive ||
 		       virtualCamActive;
 	}
 
+	// the encoders are in use, also by a packet tap or standby, and must not be reconfigured
+	inline bool EncodersBusy() const {
+		return Active() || PacketTapActive() || StandbyActive();
+	}
+
 protected:
 	void SetupAutoRemux(const char*& container);
+
+	uint64_t standbyStartedAt = 0;
+	uint64_t standbyResidentBase = 0;
+	os_cpu_usage_info_t* standbyCpuInfo = nullptr;
+
+	// the encoder whose `keyint_sec` standby capped and what to put back
+	void RestoreStandbyKeyint();
+	OBSEncoder standbyKeyintEncoder;
+	bool standbyKeyintWasSet = false;
+	int64_t standbyKeyint = 0;
+
 	std::string GetRecordingFilename(const char* path, const char* container, bool noSpace,
 					 bool overwrite, const char* format, bool ffmpeg);
 };
@@ -127,30 +240,61 @@ public:
 	void Update();
 	// check if any output is active
 	bool Active();
-
-	// set the RTMP server address, username and password
-	void SetStreamAddress(const std::string& addr, const std::string& username,
+	// check if the recording output is active
+	bool RecordingActive();
+	// render, encoder and per-output counters
+	void GetStatistics(OutputStatistics& stats);
+
+	// start or stop forwarding the encoded recording packets to `tap`
+	bool StartPacketTap(EncodedPacketTap* tap);
+	void StopPacketTap();
+	obs_encoder_t* PacketTapAudioEncoder();
+
+	// Opt-in hot standby of the recording encoders, persisted in the profile. Costs an
+	// encoder's worth of CPU and memory while enabled, `GetStandbyCost()` reports it.
+	void SetRecordingStandby(bool enabled);
+	// stop standby until the next settings refresh without changing the profile
+	void StopRecordingStandby();
+	// start standby again if the profile enables it
+	void RestoreRecordingStandby();
+	bool RecordingStandbyActive();
+	void GetStandbyCost(StandbyCost& cost);
+
+	// Stream to `addr`, `rtmp://host/app/key` (or rtmps) is split into the server and the
+	// stream key, `srt://` and `rist://` addresses are used as they are. Username and password
+	// are only sent when the server asks for them. Saved as the profile's service.
+	bool SetStreamAddress(const std::string& addr, const std::string& username,
 			      const std::string& passwd);
-	// start push output as RTMP to the given address
-	void StartStreaming();
-	// stop streaming to the RTMP server
+	// start streaming to the address of the current service
+	bool StartStreaming();
+	// stop streaming, a configured stream delay still runs out
 	void StopStreaming();
+	bool StreamingActive();
+
+	// Let the recording use the streaming encoders, a recording next to a stream then encodes
+	// once instead of twice at the cost of recording at the stream's quality. Persisted in the
+	// profile, the outputs are rebuilt so it can only change while none is active.
+	bool SetSharedEncoder(bool shared);
+	bool SharedEncoder();
 
 	// change current recoring folfer(default is the `video` folder)
-	void SetCurrentRecordingFolder(const std::string& path);
+	bool SetCurrentRecordingFolder(const std::string& path);
 	// start recording
 	bool StartRecording();
-	// pause recording if supported
+	// pause the recording if its output supports it, the file stays open
 	bool PauseRecording();
+	// continue a paused recording in the same file
+	bool ResumeRecording();
+	bool RecordingPaused();
 	// stop recording and save to file
 	void StopRecording();
 
   // set the recording format
-  void ChangeVideoContainer(const std::string& container);
+  bool ChangeVideoContainer(const std::string& container);
   // set the recording encoder
-  void ChangeVideoEncoder(const std::string& encoder);
+  bool ChangeVideoEncoder(const std::string& encoder);
   // set the recording quality
-  void ChangeVideoEncodeQuality(const std::string& quality);
+  bool ChangeVideoEncodeQuality(const std::string& quality);
   // set the recording bitrate(kbps, default is 2500kbps)
   void UpdateVideoRecodeBitrate(uint32_t bitrate);
 
@@ -163,19 +307,22 @@ public:
 	void SaveOutputSettings();
 
   // change the output size
-  void ChangeOutputSize(uint32_t width, uint32_t height);
+  bool ChangeOutputSize(uint32_t width, uint32_t height);
 
 	////////////////////////////////////////////////////////////////////////////////////////
 	// overrides
 	void OnStreamDelayStarting(int seconds) override;
 	void OnStreamDelayStopping(int seconds) override;
 	void OnStreamStarted() override;
+	void OnStreamStopping() override;
 	void OnStreamStopped(std::string error, int code) override;
 
 	void OnRecordingStarted() override;
 	void OnRecordingStopping() override;
 	void OnRecordingStopped(std::string error, int code) override;
 	void OnRecordingFileChanged(std::string path) override;
+	void OnRecordingPaused() override;
+	void OnRecordingResumed() override;
 
 	void OnReplayBufferStarted() override;
 	void OnReplayBufferStopping() override;
@@ -187,7 +334,19 @@ public:
 	void OnVirtualCamStopped(std::string error, int code) override;
 
 private:
+	// drop the prepared recording settings and prepare them again if no output is running
+	void RefreshRecordingSettings();
+	// replace the output handler by a new one of the configured output mode
+	void ResetOutputHandler();
+
 	std::unique_ptr<BasicOutputHandler> outputHandler;
+	// os_gettime_ns() of the pending `StartRecording()` call, 0 when none is pending
+	std::atomic<uint64_t> recordingRequestedAt = 0;
+
+	// process CPU usage while recording and while paused, logged on every resume
+	std::mutex recordingCpuMutex;
+	os_cpu_usage_info_t* recordingCpuInfo = nullptr;
+	double recordingCpuUsage = 0.0;
 };
 
 } // namespace core
@@ -0,0 +1,138 @@
+#include "project-saver.h"
+
+#include <algorithm>
+
+#include "util/base.h"
+
+namespace core {
+
+ProjectSaver::ProjectSaver(SnapshotFunc snapshot, PostFunc post)
+  : snapshot(std::move(snapshot)),
+    post(std::move(post)) {
+	thread = std::thread(&ProjectSaver::Run, this);
+}
+
+ProjectSaver::~ProjectSaver() {
+	Stop();
+}
+
+void ProjectSaver::MarkDirty() {
+	requests++;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (stopping)
+		return;
+
+	lastChange = Clock::now();
+	if (!dirty) {
+		dirty = true;
+		firstChange = lastChange;
+		changed.notify_one();
+	}
+}
+
+void ProjectSaver::Flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (dirty) {
+		dirty = false;
+		lock.unlock();
+		WriteFunc write = snapshot();
+		lock.lock();
+		if (write)
+			pendingWrite = std::move(write);
+	}
+
+	if (pendingWrite) {
+		Write(lock);
+		return;
+	}
+	lock.unlock();
+
+	// nothing pending, but a write of the saver thread may still be in flight
+	std::lock_guard<std::mutex> writeLock(writeMutex);
+}
+
+void ProjectSaver::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping)
+			return;
+		stopping = true;
+	}
+	*alive = false;
+	changed.notify_one();
+	thread.join();
+
+	// whatever is still pending goes out before the saver is gone
+	Flush();
+
+	uint64_t requestCount = requests;
+	uint64_t writeCount = writes;
+	blog(LOG_INFO, "[ProjectSaver::Stop] %llu save requests, %llu writes, %llu avoided",
+	     (unsigned long long)requestCount, (unsigned long long)writeCount,
+	     (unsigned long long)(requestCount > writeCount ? requestCount - writeCount : 0));
+}
+
+void ProjectSaver::Run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopping) {
+		if (pendingWrite) {
+			Write(lock);
+			continue;
+		}
+
+		if (!dirty || snapshotPending) {
+			changed.wait(lock);
+			continue;
+		}
+
+		auto delay = std::chrono::milliseconds(delayMs.load());
+		auto deadline = std::min(lastChange + delay, firstChange + delay * kMaxDelayFactor);
+		if (Clock::now() < deadline) {
+			changed.wait_until(lock, deadline);
+			continue;
+		}
+
+		snapshotPending = true;
+		lock.unlock();
+		post([this, alive = alive]() {
+			if (*alive)
+				SnapshotPosted();
+		});
+		lock.lock();
+	}
+}
+
+void ProjectSaver::SnapshotPosted() {
+	std::unique_lock<std::mutex> lock(mutex);
+	snapshotPending = false;
+	if (!dirty) {
+		// a `Flush()` took the snapshot meanwhile
+		changed.notify_one();
+		return;
+	}
+	dirty = false;
+	lock.unlock();
+
+	WriteFunc write = snapshot();
+
+	lock.lock();
+	if (write)
+		pendingWrite = std::move(write);
+	changed.notify_one();
+}
+
+void ProjectSaver::Write(std::unique_lock<std::mutex>& lock) {
+	WriteFunc write = std::move(pendingWrite);
+	pendingWrite = nullptr;
+	std::unique_lock<std::mutex> writeLock(writeMutex);
+	lock.unlock();
+
+	write();
+	writes++;
+
+	writeLock.unlock();
+	lock.lock();
+}
+
+} // namespace core
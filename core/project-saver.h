@@ -0,0 +1,85 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace core {
+
+// Writes the scene collection on a thread of its own. `MarkDirty()` only flags the project,
+// the write happens once no change came in for the debounce delay, or at the latest
+// `kMaxDelayFactor` delays after the first unsaved change so a steady stream of edits still
+// reaches the disk. A burst of changes costs one snapshot and one write.
+//
+// The snapshot reads UI state and calls frontend plugins, so it is posted to the UI thread;
+// only the write of the finished snapshot runs on the saver thread.
+class ProjectSaver {
+public:
+	typedef std::function<void()> WriteFunc;
+	// builds the save data on the UI thread and returns the write of it, nullptr to skip
+	typedef std::function<WriteFunc()> SnapshotFunc;
+	// runs a task on the UI thread later, never inline
+	typedef std::function<void(std::function<void()>)> PostFunc;
+
+	static constexpr uint32_t kDefaultDelayMs = 1000;
+	static constexpr uint32_t kMaxDelayFactor = 5;
+
+	// `Flush()`, `Stop()` and the destructor must be called on the UI thread
+	ProjectSaver(SnapshotFunc snapshot, PostFunc post);
+	~ProjectSaver();
+
+	void SetDelay(uint32_t delayMs) { this->delayMs = delayMs; }
+
+	void MarkDirty();
+	// snapshot pending changes now and return once they are on disk
+	void Flush();
+	// flush and stop the thread, `MarkDirty()` is ignored afterwards
+	void Stop();
+
+	uint64_t Requests() const { return requests; }
+	uint64_t Writes() const { return writes; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void Run();
+	// posted by `Run()` once the debounce delay is over
+	void SnapshotPosted();
+	// called with `mutex` held and a pending write, returns with `mutex` held again
+	void Write(std::unique_lock<std::mutex>& lock);
+
+	SnapshotFunc snapshot;
+	PostFunc post;
+	std::atomic<uint32_t> delayMs = kDefaultDelayMs;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	// changes that no snapshot has seen yet
+	bool dirty = false;
+	// a `SnapshotPosted()` is queued on the UI thread
+	bool snapshotPending = false;
+	// the newest snapshot that is not written yet, it supersedes older ones
+	WriteFunc pendingWrite;
+	bool stopping = false;
+	Clock::time_point firstChange;
+	Clock::time_point lastChange;
+
+	// serializes the writes of the saver thread and of `Flush()`, taken with `mutex` held so
+	// snapshots reach the disk in the order they were taken
+	std::mutex writeMutex;
+
+	// cleared by `Stop()` on the UI thread, posted snapshots that run later see it
+	std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+
+	std::atomic<uint64_t> requests = 0;
+	std::atomic<uint64_t> writes = 0;
+
+	std::thread thread;
+};
+
+} // namespace core
@@ -97,6 +97,9 @@ void Scene::AddSignalHandler(signal_handler_t* handler) {
 SceneSourceManager::SceneSourceManager() {
 	ProfileScope("MainWindow::InitOBSCallbacks");
 
+	// emitted by `App::SetCurrentScene()`
+	signal_handler_add(obs_get_signal_handler(), "void current_scene_changed(ptr source)");
+
 	signalHandlers.reserve(signalHandlers.size() + 7);
 
 	signalHandlers.emplace_back(obs_get_signal_handler(), "source_create",
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include <obs-frontend-internal.hpp>
 
 namespace core {
@@ -10,6 +12,8 @@ public:
 	virtual int Execute() = 0;
 	virtual void OnConfigureBegin() = 0;
   virtual void OnConfigureFinished() = 0;
+	// queue `task` on the UI thread's event loop, it runs after the caller returns
+	virtual void PostToUIThread(std::function<void()> task) = 0;
 };
 
 class UIWindow {
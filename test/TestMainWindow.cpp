@@ -35,7 +35,7 @@ TestMainWindow::TestMainWindow(QWidget* parent)
 			websocketSessions.erase(
 			  std::remove_if(websocketSessions.begin(), websocketSessions.end(),
 					 [state](const WebSocketSessionState& item) {
-						 return item.hdl.lock() == state.hdl.lock();
+						 return item.sessionId == state.sessionId;
 					 }),
 			  websocketSessions.end());
 		});
@@ -188,6 +188,10 @@ void TestMainWindow::changeEvent(QEvent* event) {
 }
 
 void TestMainWindow::closeEvent(QCloseEvent* event) {
+	// disconnect clients before the scene data they may still be using goes away
+	if (websocketServer->IsListening())
+		websocketServer->Stop();
+
 	CoreApp->SaveProject();
 
 	QWidget::closeEvent(event);
@@ -26,6 +26,9 @@ public:
 			cb(true);
 		}
 	}
+	virtual void PostToUIThread(std::function<void()> task) override {
+		QMetaObject::invokeMethod(this, std::move(task), Qt::QueuedConnection);
+	}
 
 private:
 	VoidFunc cb;
@@ -0,0 +1,295 @@
+#include "../core/app.h"
+
+#include "websocket.h"
+#include "event-publisher.h"
+
+using json11::Json;
+
+// private sources and missing calldata fields give null strings
+static const char* NonNull(const char* str) {
+	return str ? str : "";
+}
+
+EventPublisher::EventPublisher(WebSocketServer* server) : server(server) {}
+
+EventPublisher::~EventPublisher() {
+	Stop();
+}
+
+uint32_t EventPublisher::SetSubscriptions(const SessionPtr& session, uint32_t mask) {
+	mask &= EventSubscription::All;
+	session->SetEventSubscriptions(mask);
+	server->UpdateSubscribedTopics();
+	return mask;
+}
+
+void EventPublisher::Update(uint32_t topics) {
+	uint32_t sourceTopics = EventSubscription::Scenes | EventSubscription::Sources;
+	bool wantSources = (topics & sourceTopics) != 0;
+	if (wantSources != ((connectedTopics & sourceTopics) != 0)) {
+		if (wantSources) {
+			signal_handler_t* handler = obs_get_signal_handler();
+			sourceCreate.Connect(handler, "source_create", OnSourceCreate, this);
+			sourceRemove.Connect(handler, "source_remove", OnSourceRemove, this);
+			sourceRename.Connect(handler, "source_rename", OnSourceRename, this);
+		} else {
+			sourceCreate.Disconnect();
+			sourceRemove.Disconnect();
+			sourceRename.Disconnect();
+		}
+	}
+
+	bool wantScenes = (topics & EventSubscription::Scenes) != 0;
+	if (wantScenes != ((connectedTopics & EventSubscription::Scenes) != 0)) {
+		if (wantScenes)
+			currentSceneChanged.Connect(obs_get_signal_handler(), "current_scene_changed",
+						    OnCurrentSceneChanged, this);
+		else
+			currentSceneChanged.Disconnect();
+	}
+
+	bool wantRecording = (topics & EventSubscription::Recording) != 0;
+	if (wantRecording != ((connectedTopics & EventSubscription::Recording) != 0)) {
+		if (wantRecording) {
+			signal_handler_t* handler = obs_get_signal_handler();
+			recordingStarted.Connect(handler, "recording_started", OnRecordingStarted,
+						 this);
+			recordingStopping.Connect(handler, "recording_stopping", OnRecordingStopping,
+						  this);
+			recordingStopped.Connect(handler, "recording_stopped", OnRecordingStopped,
+						 this);
+			recordingFileChanged.Connect(handler, "recording_file_changed",
+						     OnRecordingFileChanged, this);
+			recordingPaused.Connect(handler, "recording_paused", OnRecordingPaused,
+						this);
+			recordingResumed.Connect(handler, "recording_resumed", OnRecordingResumed,
+						 this);
+		} else {
+			recordingStarted.Disconnect();
+			recordingStopping.Disconnect();
+			recordingStopped.Disconnect();
+			recordingFileChanged.Disconnect();
+			recordingPaused.Disconnect();
+			recordingResumed.Disconnect();
+		}
+	}
+
+	bool wantStreaming = (topics & EventSubscription::Streaming) != 0;
+	if (wantStreaming != ((connectedTopics & EventSubscription::Streaming) != 0)) {
+		if (wantStreaming) {
+			signal_handler_t* handler = obs_get_signal_handler();
+			streamDelayStarting.Connect(handler, "streaming_delay_starting",
+						    OnStreamDelayStarting, this);
+			streamStarted.Connect(handler, "streaming_started", OnStreamStarted, this);
+			streamStopping.Connect(handler, "streaming_stopping", OnStreamStopping, this);
+			streamStopped.Connect(handler, "streaming_stopped", OnStreamStopped, this);
+		} else {
+			streamDelayStarting.Disconnect();
+			streamStarted.Disconnect();
+			streamStopping.Disconnect();
+			streamStopped.Disconnect();
+		}
+	}
+
+	bool wantLogs = (topics & EventSubscription::Logs) != 0;
+	if (wantLogs != ((connectedTopics & EventSubscription::Logs) != 0))
+		core::SetLogListener(wantLogs ? OnLog : nullptr, this);
+
+	connectedTopics = topics;
+}
+
+Json EventPublisher::MakeEvent(const char* eventType, Json::object eventData) {
+	return Json::object{
+	  {"op", WebSocketOpCode::Event},
+	  {"d",
+	   Json::object{
+	     {"eventType", eventType},
+	     {"eventData", std::move(eventData)},
+	   }},
+	};
+}
+
+uint32_t EventPublisher::TopicOf(obs_source_t* source) {
+	return obs_source_get_type(source) == OBS_SOURCE_TYPE_SCENE ? EventSubscription::Scenes
+								      : EventSubscription::Sources;
+}
+
+void EventPublisher::Publish(uint32_t topic, const char* eventType, Json::object eventData) {
+	server->Broadcast(MakeEvent(eventType, std::move(eventData)), topic);
+}
+
+void EventPublisher::OnSourceCreate(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	obs_source_t* source = (obs_source_t*)calldata_ptr(params, "source");
+
+	uint32_t topic = TopicOf(source);
+	if (!publisher->server->HasSubscribers(topic))
+		return;
+
+	publisher->Publish(topic,
+			   topic == EventSubscription::Scenes ? "SceneCreated" : "SourceCreated",
+			   {
+			     {"name", NonNull(obs_source_get_name(source))},
+			     {"kind", NonNull(obs_source_get_id(source))},
+			   });
+}
+
+void EventPublisher::OnSourceRemove(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	obs_source_t* source = (obs_source_t*)calldata_ptr(params, "source");
+
+	uint32_t topic = TopicOf(source);
+	if (!publisher->server->HasSubscribers(topic))
+		return;
+
+	publisher->Publish(topic,
+			   topic == EventSubscription::Scenes ? "SceneRemoved" : "SourceRemoved",
+			   {
+			     {"name", NonNull(obs_source_get_name(source))},
+			   });
+}
+
+void EventPublisher::OnSourceRename(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	obs_source_t* source = (obs_source_t*)calldata_ptr(params, "source");
+
+	uint32_t topic = TopicOf(source);
+	if (!publisher->server->HasSubscribers(topic))
+		return;
+
+	publisher->Publish(topic,
+			   topic == EventSubscription::Scenes ? "SceneNameChanged"
+							      : "SourceNameChanged",
+			   {
+			     {"oldName", NonNull(calldata_string(params, "prev_name"))},
+			     {"name", NonNull(calldata_string(params, "new_name"))},
+			   });
+}
+
+void EventPublisher::OnCurrentSceneChanged(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Scenes))
+		return;
+
+	obs_source_t* source = (obs_source_t*)calldata_ptr(params, "source");
+	publisher->Publish(EventSubscription::Scenes, "CurrentSceneChanged",
+			   {
+			     {"name", NonNull(obs_source_get_name(source))},
+			   });
+}
+
+void EventPublisher::OnRecordingStarted(void* data, calldata_t* /* params */) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Recording))
+		return;
+
+	publisher->Publish(EventSubscription::Recording, "RecordingStarted", {});
+}
+
+void EventPublisher::OnRecordingStopping(void* data, calldata_t* /* params */) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Recording))
+		return;
+
+	publisher->Publish(EventSubscription::Recording, "RecordingStopping", {});
+}
+
+void EventPublisher::OnRecordingStopped(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Recording))
+		return;
+
+	publisher->Publish(EventSubscription::Recording, "RecordingStopped",
+			   {
+			     {"code", (int)calldata_int(params, "code")},
+			     {"error", NonNull(calldata_string(params, "error"))},
+			   });
+}
+
+void EventPublisher::OnRecordingFileChanged(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Recording))
+		return;
+
+	publisher->Publish(EventSubscription::Recording, "RecordingFileChanged",
+			   {
+			     {"path", NonNull(calldata_string(params, "path"))},
+			   });
+}
+
+void EventPublisher::OnRecordingPaused(void* data, calldata_t* /* params */) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Recording))
+		return;
+
+	publisher->Publish(EventSubscription::Recording, "RecordingPaused", {});
+}
+
+void EventPublisher::OnRecordingResumed(void* data, calldata_t* /* params */) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Recording))
+		return;
+
+	publisher->Publish(EventSubscription::Recording, "RecordingResumed", {});
+}
+
+void EventPublisher::OnStreamDelayStarting(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Streaming))
+		return;
+
+	publisher->Publish(EventSubscription::Streaming, "StreamDelayStarting",
+			   {
+			     {"seconds", (int)calldata_int(params, "seconds")},
+			   });
+}
+
+void EventPublisher::OnStreamStarted(void* data, calldata_t* /* params */) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Streaming))
+		return;
+
+	publisher->Publish(EventSubscription::Streaming, "StreamStarted", {});
+}
+
+void EventPublisher::OnStreamStopping(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Streaming))
+		return;
+
+	publisher->Publish(EventSubscription::Streaming, "StreamStopping",
+			   {
+			     {"delay", (int)calldata_int(params, "delay")},
+			   });
+}
+
+void EventPublisher::OnStreamStopped(void* data, calldata_t* params) {
+	EventPublisher* publisher = static_cast<EventPublisher*>(data);
+	if (!publisher->server->HasSubscribers(EventSubscription::Streaming))
+		return;
+
+	publisher->Publish(EventSubscription::Streaming, "StreamStopped",
+			   {
+			     {"code", (int)calldata_int(params, "code")},
+			     {"error", NonNull(calldata_string(params, "error"))},
+			   });
+}
+
+void EventPublisher::OnLog(int level, const char* message, void* param) {
+	// sending may log itself, those lines are not forwarded
+	static thread_local bool publishing = false;
+	if (publishing || level > LOG_INFO)
+		return;
+
+	EventPublisher* publisher = static_cast<EventPublisher*>(param);
+	if (!publisher->server->HasSubscribers(EventSubscription::Logs))
+		return;
+
+	publishing = true;
+	publisher->Publish(EventSubscription::Logs, "LogMessage",
+			   {
+			     {"level", level},
+			     {"message", message},
+			   });
+	publishing = false;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+#include <obs.hpp>
+#include <json11.hpp>
+
+#include "websocket-session.h"
+
+class WebSocketServer;
+
+// Turns libobs and core signals into events for the `Recording`, `Streaming`, `Scenes`,
+// `Sources` and `Logs` topics.
+//
+// A signal is only connected while at least one session subscribed to its topic, so events
+// nobody wants cost nothing on the threads that emit them. Handlers check the subscribers
+// again before building the event, the union may have shrunk since the signal was connected.
+//
+// `SetSubscriptions()`, `Update()` and `Stop()` run on the thread the server lives on.
+class EventPublisher {
+public:
+	explicit EventPublisher(WebSocketServer* server);
+	~EventPublisher();
+
+	// replace the topics `session` receives, returns the mask actually stored
+	uint32_t SetSubscriptions(const SessionPtr& session, uint32_t mask);
+	// connect the signals of `topics` and disconnect the others
+	void Update(uint32_t topics);
+	void Stop() { Update(0); }
+
+	static json11::Json MakeEvent(const char* eventType, json11::Json::object eventData);
+
+private:
+	// run on the thread that emitted the signal
+	static void OnSourceCreate(void* data, calldata_t* params);
+	static void OnSourceRemove(void* data, calldata_t* params);
+	static void OnSourceRename(void* data, calldata_t* params);
+	static void OnCurrentSceneChanged(void* data, calldata_t* params);
+	static void OnRecordingStarted(void* data, calldata_t* params);
+	static void OnRecordingStopping(void* data, calldata_t* params);
+	static void OnRecordingStopped(void* data, calldata_t* params);
+	static void OnRecordingFileChanged(void* data, calldata_t* params);
+	static void OnRecordingPaused(void* data, calldata_t* params);
+	static void OnRecordingResumed(void* data, calldata_t* params);
+	static void OnStreamDelayStarting(void* data, calldata_t* params);
+	static void OnStreamStarted(void* data, calldata_t* params);
+	static void OnStreamStopping(void* data, calldata_t* params);
+	static void OnStreamStopped(void* data, calldata_t* params);
+	static void OnLog(int level, const char* message, void* param);
+
+	// topic of events about `source`, scenes and other sources are separate topics
+	static uint32_t TopicOf(obs_source_t* source);
+	void Publish(uint32_t topic, const char* eventType, json11::Json::object eventData);
+
+	WebSocketServer* server;
+	uint32_t connectedTopics = 0;
+
+	// scenes and sources
+	OBSSignal sourceCreate;
+	OBSSignal sourceRemove;
+	OBSSignal sourceRename;
+	OBSSignal currentSceneChanged;
+
+	// recording
+	OBSSignal recordingStarted;
+	OBSSignal recordingStopping;
+	OBSSignal recordingStopped;
+	OBSSignal recordingFileChanged;
+	OBSSignal recordingPaused;
+	OBSSignal recordingResumed;
+
+	// streaming
+	OBSSignal streamDelayStarting;
+	OBSSignal streamStarted;
+	OBSSignal streamStopping;
+	OBSSignal streamStopped;
+};
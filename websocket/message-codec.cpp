@@ -0,0 +1,527 @@
+#include <cmath>
+#include <cstring>
+#include <charconv>
+
+#include "message-codec.h"
+
+namespace codec {
+
+bool EncodingFromSubprotocol(const std::string& subprotocol, WebSocketEncoding& encoding) {
+	if (subprotocol == SUBPROTOCOL_JSON) {
+		encoding = WebSocketEncoding::Json;
+		return true;
+	} else if (subprotocol == SUBPROTOCOL_MSGPACK) {
+		encoding = WebSocketEncoding::MsgPack;
+		return true;
+	}
+
+	return false;
+}
+
+std::string Encode(WebSocketEncoding encoding, const json11::Json& message) {
+	if (encoding == WebSocketEncoding::MsgPack)
+		return EncodeMsgPack(message);
+
+	return message.dump();
+}
+
+bool Decode(WebSocketEncoding encoding, const std::string& payload, json11::Json& message,
+	    std::string& error) {
+	if (encoding == WebSocketEncoding::MsgPack)
+		return DecodeMsgPack(payload, message, error);
+
+	message = json11::Json::parse(payload, error);
+	return error.empty();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// encoder
+
+static inline void PutBE(std::string& out, uint64_t value, size_t bytes) {
+	for (size_t i = bytes; i > 0; i--) out.push_back(char((value >> ((i - 1) * 8)) & 0xff));
+}
+
+static void PutLength(std::string& out, size_t len, uint8_t fix, uint8_t fixMax, uint8_t b8,
+		      uint8_t b16, uint8_t b32) {
+	if (fix && len <= fixMax) {
+		out.push_back(char(fix | len));
+	} else if (b8 && len <= 0xff) {
+		out.push_back(char(b8));
+		PutBE(out, len, 1);
+	} else if (len <= 0xffff) {
+		out.push_back(char(b16));
+		PutBE(out, len, 2);
+	} else {
+		out.push_back(char(b32));
+		PutBE(out, len, 4);
+	}
+}
+
+static void PutNumber(std::string& out, double value) {
+	// json11 keeps every number as a double, send integral values as msgpack ints
+	if (std::trunc(value) == value && value >= -9223372036854775808.0 &&
+	    value < 18446744073709551616.0) {
+		if (value >= 0) {
+			uint64_t v = uint64_t(value);
+			if (v <= 0x7f) {
+				out.push_back(char(v));
+			} else if (v <= 0xff) {
+				out.push_back(char(0xcc));
+				PutBE(out, v, 1);
+			} else if (v <= 0xffff) {
+				out.push_back(char(0xcd));
+				PutBE(out, v, 2);
+			} else if (v <= 0xffffffffull) {
+				out.push_back(char(0xce));
+				PutBE(out, v, 4);
+			} else {
+				out.push_back(char(0xcf));
+				PutBE(out, v, 8);
+			}
+		} else {
+			int64_t v = int64_t(value);
+			if (v >= -32) {
+				out.push_back(char(int8_t(v)));
+			} else if (v >= INT8_MIN) {
+				out.push_back(char(0xd0));
+				PutBE(out, uint64_t(v), 1);
+			} else if (v >= INT16_MIN) {
+				out.push_back(char(0xd1));
+				PutBE(out, uint64_t(v), 2);
+			} else if (v >= INT32_MIN) {
+				out.push_back(char(0xd2));
+				PutBE(out, uint64_t(v), 4);
+			} else {
+				out.push_back(char(0xd3));
+				PutBE(out, uint64_t(v), 8);
+			}
+		}
+		return;
+	}
+
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	out.push_back(char(0xcb));
+	PutBE(out, bits, 8);
+}
+
+static void PutString(std::string& out, const std::string& value) {
+	PutLength(out, value.size(), 0xa0, 31, 0xd9, 0xda, 0xdb);
+	out.append(value);
+}
+
+static void PutValue(std::string& out, const json11::Json& value) {
+	switch (value.type()) {
+	case json11::Json::NUL: out.push_back(char(0xc0)); break;
+	case json11::Json::BOOL: out.push_back(char(value.bool_value() ? 0xc3 : 0xc2)); break;
+	case json11::Json::NUMBER: PutNumber(out, value.number_value()); break;
+	case json11::Json::STRING: PutString(out, value.string_value()); break;
+	case json11::Json::ARRAY: {
+		auto& items = value.array_items();
+		PutLength(out, items.size(), 0x90, 15, 0, 0xdc, 0xdd);
+		for (auto& item : items) PutValue(out, item);
+		break;
+	}
+	case json11::Json::OBJECT: {
+		auto& items = value.object_items();
+		PutLength(out, items.size(), 0x80, 15, 0, 0xde, 0xdf);
+		for (auto& [key, item] : items) {
+			PutString(out, key);
+			PutValue(out, item);
+		}
+		break;
+	}
+	}
+}
+
+std::string EncodeMsgPack(const json11::Json& message) {
+	std::string out;
+	out.reserve(64);
+	PutValue(out, message);
+	return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// decoder
+
+#define MSGPACK_MAX_DEPTH 64
+
+namespace {
+struct Reader {
+	const uint8_t* data;
+	size_t size;
+	size_t pos = 0;
+	std::string& error;
+
+	bool Need(size_t n) {
+		if (size - pos >= n)
+			return true;
+		error = "unexpected end of msgpack data";
+		return false;
+	}
+
+	bool ReadBE(size_t bytes, uint64_t& value) {
+		if (!Need(bytes))
+			return false;
+		value = 0;
+		for (size_t i = 0; i < bytes; i++) value = (value << 8) | data[pos++];
+		return true;
+	}
+
+	bool ReadString(size_t len, json11::Json& out) {
+		if (!Need(len))
+			return false;
+		out = std::string(reinterpret_cast<const char*>(data + pos), len);
+		pos += len;
+		return true;
+	}
+
+	bool ReadArray(size_t len, json11::Json& out, int depth) {
+		// every element takes at least one byte, reject bogus lengths before allocating
+		if (!Need(len))
+			return false;
+		json11::Json::array items;
+		items.reserve(len);
+		for (size_t i = 0; i < len; i++) {
+			json11::Json item;
+			if (!ReadValue(item, depth + 1))
+				return false;
+			items.push_back(std::move(item));
+		}
+		out = std::move(items);
+		return true;
+	}
+
+	bool ReadMap(size_t len, json11::Json& out, int depth) {
+		if (!Need(len))
+			return false;
+		json11::Json::object items;
+		for (size_t i = 0; i < len; i++) {
+			json11::Json key, item;
+			if (!ReadValue(key, depth + 1))
+				return false;
+			if (!key.is_string()) {
+				error = "msgpack map keys must be strings";
+				return false;
+			}
+			if (!ReadValue(item, depth + 1))
+				return false;
+			items[key.string_value()] = std::move(item);
+		}
+		out = std::move(items);
+		return true;
+	}
+
+	bool ReadValue(json11::Json& out, int depth) {
+		if (depth > MSGPACK_MAX_DEPTH) {
+			error = "msgpack data nested too deeply";
+			return false;
+		}
+		if (!Need(1))
+			return false;
+
+		uint8_t tag = data[pos++];
+		uint64_t v = 0;
+
+		if (tag <= 0x7f) {
+			out = double(tag);
+			return true;
+		} else if (tag >= 0xe0) {
+			out = double(int8_t(tag));
+			return true;
+		} else if ((tag & 0xe0) == 0xa0) {
+			return ReadString(tag & 0x1f, out);
+		} else if ((tag & 0xf0) == 0x90) {
+			return ReadArray(tag & 0x0f, out, depth);
+		} else if ((tag & 0xf0) == 0x80) {
+			return ReadMap(tag & 0x0f, out, depth);
+		}
+
+		switch (tag) {
+		case 0xc0: out = nullptr; return true;
+		case 0xc2: out = false; return true;
+		case 0xc3: out = true; return true;
+		case 0xcc:
+		case 0xcd:
+		case 0xce:
+		case 0xcf:
+			if (!ReadBE(size_t(1) << (tag - 0xcc), v))
+				return false;
+			out = double(v);
+			return true;
+		case 0xd0:
+			if (!ReadBE(1, v))
+				return false;
+			out = double(int8_t(v));
+			return true;
+		case 0xd1:
+			if (!ReadBE(2, v))
+				return false;
+			out = double(int16_t(v));
+			return true;
+		case 0xd2:
+			if (!ReadBE(4, v))
+				return false;
+			out = double(int32_t(v));
+			return true;
+		case 0xd3:
+			if (!ReadBE(8, v))
+				return false;
+			out = double(int64_t(v));
+			return true;
+		case 0xca: {
+			if (!ReadBE(4, v))
+				return false;
+			uint32_t bits = uint32_t(v);
+			float f;
+			memcpy(&f, &bits, sizeof(f));
+			out = double(f);
+			return true;
+		}
+		case 0xcb: {
+			if (!ReadBE(8, v))
+				return false;
+			double d;
+			memcpy(&d, &v, sizeof(d));
+			out = d;
+			return true;
+		}
+		// bin is treated like a string, json11 has no byte array type
+		case 0xc4:
+		case 0xd9:
+			return ReadBE(1, v) && ReadString(size_t(v), out);
+		case 0xc5:
+		case 0xda:
+			return ReadBE(2, v) && ReadString(size_t(v), out);
+		case 0xc6:
+		case 0xdb:
+			return ReadBE(4, v) && ReadString(size_t(v), out);
+		case 0xdc: return ReadBE(2, v) && ReadArray(size_t(v), out, depth);
+		case 0xdd: return ReadBE(4, v) && ReadArray(size_t(v), out, depth);
+		case 0xde: return ReadBE(2, v) && ReadMap(size_t(v), out, depth);
+		case 0xdf: return ReadBE(4, v) && ReadMap(size_t(v), out, depth);
+		default: break;
+		}
+
+		error = "unsupported msgpack type";
+		return false;
+	}
+};
+} // namespace
+
+bool DecodeMsgPack(const std::string& payload, json11::Json& message, std::string& error) {
+	error.clear();
+
+	Reader reader{reinterpret_cast<const uint8_t*>(payload.data()), payload.size(), 0, error};
+	if (!reader.ReadValue(message, 0))
+		return false;
+
+	if (reader.pos != payload.size()) {
+		error = "trailing bytes after msgpack data";
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// request fast path
+
+namespace {
+struct RequestScanner {
+	const char* pos;
+	const char* end;
+
+	void SkipSpace() {
+		while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+			pos++;
+	}
+
+	bool Consume(char c) {
+		SkipSpace();
+		if (pos == end || *pos != c)
+			return false;
+		pos++;
+		return true;
+	}
+
+	// strings with `\u` escapes are left to json11
+	bool ReadString(std::string& out) {
+		if (!Consume('"'))
+			return false;
+
+		out.clear();
+		// plain characters are copied at once, escapes and control characters are
+		// handled below
+		const char* start = pos;
+		while (pos < end && *pos != '"' && *pos != '\\' && (unsigned char)*pos >= 0x20)
+			pos++;
+		out.assign(start, pos);
+
+		while (pos < end && *pos != '"') {
+			if (*pos != '\\') {
+				if ((unsigned char)*pos < 0x20)
+					return false;
+				out.push_back(*pos++);
+				continue;
+			}
+			if (++pos == end)
+				return false;
+			switch (*pos++) {
+			case '"': out.push_back('"'); break;
+			case '\\': out.push_back('\\'); break;
+			case '/': out.push_back('/'); break;
+			case 'b': out.push_back('\b'); break;
+			case 'f': out.push_back('\f'); break;
+			case 'n': out.push_back('\n'); break;
+			case 'r': out.push_back('\r'); break;
+			case 't': out.push_back('\t'); break;
+			default: return false;
+			}
+		}
+
+		if (pos == end)
+			return false;
+		pos++;
+		return true;
+	}
+
+	bool ReadLiteral(const char* literal, size_t size) {
+		if (size_t(end - pos) < size || memcmp(pos, literal, size) != 0)
+			return false;
+		pos += size;
+		return true;
+	}
+
+	static bool IsDigit(const char* ch, const char* last) {
+		return ch < last && *ch >= '0' && *ch <= '9';
+	}
+
+	// from_chars takes "1." and "1.e5", Json wants digits after the point and in the exponent
+	bool IsJsonNumber(const char* digits, const char* last) const {
+		for (const char* ch = digits; ch < last; ch++) {
+			if (*ch == '.' && !IsDigit(ch + 1, last))
+				return false;
+			if (*ch == 'e' || *ch == 'E') {
+				const char* exponent = ch + 1;
+				if (exponent < last && (*exponent == '+' || *exponent == '-'))
+					exponent++;
+				if (!IsDigit(exponent, last))
+					return false;
+			}
+		}
+
+		// "1e" and "1." parse as 1, the rest must not look like part of the number
+		return last == end || (*last != '.' && *last != 'e' && *last != 'E');
+	}
+
+	bool ReadScalar(json11::Json& out) {
+		SkipSpace();
+		if (pos == end)
+			return false;
+
+		switch (*pos) {
+		case '"': {
+			std::string value;
+			if (!ReadString(value))
+				return false;
+			out = std::move(value);
+			return true;
+		}
+		case 't': out = true; return ReadLiteral("true", 4);
+		case 'f': out = false; return ReadLiteral("false", 5);
+		case 'n': out = nullptr; return ReadLiteral("null", 4);
+		default: break;
+		}
+
+		// from_chars also takes "inf", "nan" and ".5", Json numbers start with a digit
+		const char* digits = *pos == '-' ? pos + 1 : pos;
+		if (digits == end || *digits < '0' || *digits > '9' ||
+		    (*digits == '0' && end - digits > 1 && digits[1] >= '0' && digits[1] <= '9'))
+			return false;
+		double value;
+		auto result = std::from_chars(pos, end, value);
+		if (result.ec != std::errc() || result.ptr == pos ||
+		    !IsJsonNumber(digits, result.ptr))
+			return false;
+		pos = result.ptr;
+		out = value;
+		return true;
+	}
+
+	// iterate the members of an object, `member` reads the value of each key
+	template<typename Member> bool ReadObject(Member&& member) {
+		if (!Consume('{'))
+			return false;
+		if (Consume('}'))
+			return true;
+
+		std::string key;
+		do {
+			if (!ReadString(key) || !Consume(':') || !member(key))
+				return false;
+		} while (Consume(','));
+
+		return Consume('}');
+	}
+
+	bool ReadFlatObject(json11::Json& out) {
+		SkipSpace();
+		if (ReadLiteral("null", 4)) {
+			out = nullptr;
+			return true;
+		}
+
+		json11::Json::object members;
+		bool ok = ReadObject([&](const std::string& key) {
+			json11::Json value;
+			if (!ReadScalar(value))
+				return false;
+			members[key] = std::move(value);
+			return true;
+		});
+		out = std::move(members);
+		return ok;
+	}
+};
+} // namespace
+
+bool DecodeJsonRequest(const std::string& payload, RequestMessage& message) {
+	RequestScanner scanner{payload.data(), payload.data() + payload.size()};
+	bool hasOp = false;
+	bool hasData = false;
+	bool hasType = false;
+
+	bool ok = scanner.ReadObject([&](const std::string& key) {
+		if (key == "op") {
+			json11::Json op;
+			if (!scanner.ReadScalar(op) || !op.is_number())
+				return false;
+			message.op = op.int_value();
+			hasOp = true;
+			return true;
+		}
+		if (key != "d")
+			return false;
+
+		hasData = true;
+		return scanner.ReadObject([&](const std::string& field) {
+			if (field == "requestType") {
+				hasType = true;
+				return scanner.ReadString(message.requestType);
+			}
+			if (field == "requestId")
+				return scanner.ReadString(message.requestId);
+			if (field == "requestData")
+				return scanner.ReadFlatObject(message.requestData);
+			return false;
+		});
+	});
+	if (!ok || !hasOp || !hasData || !hasType)
+		return false;
+
+	scanner.SkipSpace();
+	return scanner.pos == scanner.end;
+}
+
+} // namespace codec
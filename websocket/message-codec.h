@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+
+#include <json11.hpp>
+
+// Wire encodings a session can negotiate through the `Sec-WebSocket-Protocol` header
+enum class WebSocketEncoding : uint8_t {
+	Json = 0,
+	MsgPack = 1,
+};
+
+#define SUBPROTOCOL_JSON "recorder.json"
+#define SUBPROTOCOL_MSGPACK "recorder.msgpack"
+
+namespace codec {
+
+// map a requested subprotocol to an encoding, returns false if it is not supported
+bool EncodingFromSubprotocol(const std::string& subprotocol, WebSocketEncoding& encoding);
+
+// Json is sent as text frames, MsgPack as binary frames
+inline bool IsBinary(WebSocketEncoding encoding) {
+	return encoding != WebSocketEncoding::Json;
+}
+
+// serialize a message with the session encoding
+std::string Encode(WebSocketEncoding encoding, const json11::Json& message);
+// parse a frame payload with the session encoding, `error` is set on failure
+bool Decode(WebSocketEncoding encoding, const std::string& payload, json11::Json& message,
+	    std::string& error);
+
+// `{"op": ..., "d": {"requestType": ..., "requestId": ..., "requestData": {...}}}` read
+// straight from a Json payload by `DecodeJsonRequest()`
+struct RequestMessage {
+	int op = 0;
+	std::string requestType;
+	std::string requestId;
+	json11::Json requestData;
+};
+
+// Fast path for the command messages, reads the fields without building a DOM for the
+// envelope. `requestData` must be flat: strings, numbers, booleans and null only. Returns false
+// for anything else, including invalid Json, the caller then falls back to `Decode()`, which
+// also reports the errors.
+bool DecodeJsonRequest(const std::string& payload, RequestMessage& message);
+
+// MessagePack <-> json11 conversion, binary and ext types are not supported
+std::string EncodeMsgPack(const json11::Json& message);
+bool DecodeMsgPack(const std::string& payload, json11::Json& message, std::string& error);
+
+} // namespace codec
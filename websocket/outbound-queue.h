@@ -0,0 +1,155 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+
+// What to do when a session's outbound queue would exceed its limits
+enum class SlowConsumerPolicy : uint8_t {
+	// drop the oldest queued topic (telemetry) messages to make room
+	DropOldest = 0,
+	// replace a queued message of the same snapshot topic, where the newer message carries
+	// the full value. Other topics fall back to `DropOldest`.
+	Coalesce = 1,
+	// close the session with `WebSocketCloseCode::SlowConsumer`
+	Disconnect = 2,
+};
+
+// Messages waiting to be handed to websocketpp for one session. Frames are only handed over
+// while the connection's own write buffer is small, everything beyond that stays here where
+// it can still be dropped or coalesced.
+//
+// Messages with topic 0 are replies and control messages, they are never dropped or
+// coalesced. If they alone exceed the limits the queue reports an overflow.
+template<typename Frame> class OutboundQueue {
+public:
+	enum PushResult {
+		kQueued,
+		// the message itself was the oldest droppable one
+		kDropped,
+		kOverflow,
+	};
+
+	struct Limits {
+		size_t maxBytes;
+		size_t maxMessages;
+		SlowConsumerPolicy policy;
+		// topics `Coalesce` may replace, each of their messages supersedes the previous one
+		uint32_t coalescableTopics;
+	};
+
+	PushResult Push(Frame frame, size_t bytes, uint32_t topic, const Limits& limits) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		bool coalesce = limits.policy == SlowConsumerPolicy::Coalesce;
+		if (coalesce && (topic & limits.coalescableTopics)) {
+			for (auto& entry : entries) {
+				if (entry.topic != topic)
+					continue;
+
+				queuedBytes = queuedBytes - entry.bytes + bytes;
+				entry.frame = std::move(frame);
+				entry.bytes = bytes;
+				coalesced++;
+
+				// a larger replacement can exceed the limits as well. `entry` is the
+				// first of its topic, so it is the one dropped once it is the oldest.
+				while (OverLimits(entries.size(), queuedBytes, limits)) {
+					if (DropOldest() == topic)
+						return kDropped;
+				}
+				return kQueued;
+			}
+		}
+
+		while (OverLimits(entries.size() + 1, queuedBytes + bytes, limits)) {
+			if (limits.policy == SlowConsumerPolicy::Disconnect)
+				return kOverflow;
+			if (DropOldest())
+				continue;
+			if (!topic)
+				return kOverflow;
+
+			dropped++;
+			return kDropped;
+		}
+
+		entries.push_back({std::move(frame), bytes, topic});
+		queuedBytes += bytes;
+		return kQueued;
+	}
+
+	// Hand queued frames to `send` in order for as long as `ready()` allows. Runs under the
+	// queue lock so concurrent drains can never reorder frames. Returns true if frames
+	// are left in the queue.
+	template<typename Ready, typename Send> bool Drain(Ready&& ready, Send&& send) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		while (!entries.empty() && ready()) {
+			Entry entry = std::move(entries.front());
+			entries.pop_front();
+			queuedBytes -= entry.bytes;
+
+			send(entry.frame);
+		}
+
+		return !entries.empty();
+	}
+
+	void Clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		queuedBytes = 0;
+	}
+
+	// set while a delayed drain is pending, returns false if one already was
+	bool ArmRetry() { return !retryArmed.exchange(true); }
+	void DisarmRetry() { retryArmed = false; }
+
+	size_t Depth() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+	size_t Bytes() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return queuedBytes;
+	}
+	uint64_t Dropped() const { return dropped; }
+	uint64_t Coalesced() const { return coalesced; }
+
+private:
+	struct Entry {
+		Frame frame;
+		size_t bytes;
+		uint32_t topic;
+	};
+
+	// `messages` and `bytes` are the totals the queue would hold
+	static bool OverLimits(size_t messages, size_t bytes, const Limits& limits) {
+		return messages > limits.maxMessages || bytes > limits.maxBytes;
+	}
+
+	// returns the topic of the dropped message, 0 if only replies are queued
+	uint32_t DropOldest() {
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			if (!it->topic)
+				continue;
+
+			uint32_t topic = it->topic;
+			queuedBytes -= it->bytes;
+			entries.erase(it);
+			dropped++;
+			return topic;
+		}
+
+		return 0;
+	}
+
+	std::mutex mutex;
+	std::deque<Entry> entries;
+	size_t queuedBytes = 0;
+
+	std::atomic<bool> retryArmed = false;
+	std::atomic<uint64_t> dropped = 0;
+	std::atomic<uint64_t> coalesced = 0;
+};
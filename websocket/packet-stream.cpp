@@ -0,0 +1,317 @@
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <QByteArray>
+#include <obs-avc.h>
+#ifdef ENABLE_HEVC
+#include <obs-hevc.h>
+#endif
+
+#include "../core/app.h"
+
+#include "websocket.h"
+#include "packet-stream.h"
+
+using json11::Json;
+
+static void AppendInt64(std::string& out, int64_t value) {
+	for (int shift = 56; shift >= 0; shift -= 8)
+		out.push_back(char((uint64_t(value) >> shift) & 0xff));
+}
+
+static int64_t ToMicroseconds(int64_t ts, int32_t num, int32_t den) {
+	return den ? ts * 1000000 * num / den : 0;
+}
+
+static std::string ToBase64(const uint8_t* data, size_t size) {
+	if (!data || !size)
+		return std::string();
+	return QByteArray::fromRawData((const char*)data, int(size)).toBase64().toStdString();
+}
+
+static bool IsAnnexB(obs_encoder_t* encoder) {
+	const char* codec = obs_encoder_get_codec(encoder);
+	return codec && (strcmp(codec, "h264") == 0 || strcmp(codec, "hevc") == 0);
+}
+
+static const uint8_t* FindStartCode(const uint8_t* pos, const uint8_t* end) {
+	for (; end - pos >= 3; pos++) {
+		if (pos[0] == 0 && pos[1] == 0 && pos[2] == 1)
+			return pos;
+	}
+	return end;
+}
+
+// Annex B start codes become 4 byte big endian lengths, the layout avcC and hvcC announce
+static void AppendLengthPrefixed(std::string& out, const uint8_t* data, size_t size) {
+	const uint8_t* end = data + size;
+	const uint8_t* nal = FindStartCode(data, end);
+	while (nal < end) {
+		nal += 3;
+		const uint8_t* next = FindStartCode(nal, end);
+
+		// the leading zero of a 4 byte start code is not part of the unit before it
+		const uint8_t* nalEnd = next;
+		while (next < end && nalEnd > nal && nalEnd[-1] == 0)
+			nalEnd--;
+
+		uint32_t length = uint32_t(nalEnd - nal);
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back(char((length >> shift) & 0xff));
+		out.append((const char*)nal, length);
+
+		nal = next;
+	}
+}
+
+// WebCodecs codec string and decoder description of a video encoder, see the
+// "AVC/HEVC WebCodecs Registration" and ISO/IEC 14496-15 annex E
+static void DescribeVideo(obs_encoder_t* encoder, std::string& codec, std::string& description) {
+	const char* name = obs_encoder_get_codec(encoder);
+	codec = name ? name : "";
+	description.clear();
+
+	uint8_t* extraData = nullptr;
+	size_t extraSize = 0;
+	if (!obs_encoder_get_extra_data(encoder, &extraData, &extraSize) || !extraData)
+		return;
+
+	uint8_t* record = nullptr;
+	size_t recordSize = 0;
+	char buffer[64];
+	if (codec == "h264") {
+		recordSize = obs_parse_avc_header(&record, extraData, extraSize);
+		// profile, constraint flags and level of the avcC record
+		if (recordSize >= 4) {
+			snprintf(buffer, sizeof(buffer), "avc1.%02x%02x%02x", record[1], record[2],
+				 record[3]);
+			codec = buffer;
+		}
+#ifdef ENABLE_HEVC
+	} else if (codec == "hevc") {
+		recordSize = obs_parse_hevc_header(&record, extraData, extraSize);
+		if (recordSize >= 13) {
+			static const char* profileSpaces[] = {"", "A", "B", "C"};
+			uint32_t compatibility = 0;
+			for (int i = 2; i < 6; i++)
+				compatibility = compatibility << 8 | record[i];
+			// the compatibility flags are written in reverse bit order
+			uint32_t reversed = 0;
+			for (int bit = 0; bit < 32; bit++) {
+				if (compatibility & (1u << bit))
+					reversed |= 1u << (31 - bit);
+			}
+
+			snprintf(buffer, sizeof(buffer), "hvc1.%s%u.%X.%c%u",
+				 profileSpaces[record[1] >> 6], record[1] & 0x1f, reversed,
+				 (record[1] & 0x20) ? 'H' : 'L', record[12]);
+			codec = buffer;
+
+			// constraint flags, trailing zero bytes are left out
+			int last = 11;
+			while (last >= 6 && record[last] == 0)
+				last--;
+			for (int i = 6; i <= last; i++) {
+				snprintf(buffer, sizeof(buffer), ".%02X", record[i]);
+				codec += buffer;
+			}
+		}
+#endif
+	} else {
+		description = ToBase64(extraData, extraSize);
+		return;
+	}
+
+	description = ToBase64(record, recordSize);
+	bfree(record);
+}
+
+static void DescribeAudio(obs_encoder_t* encoder, std::string& codec, std::string& description) {
+	const char* name = obs_encoder_get_codec(encoder);
+	codec = name ? name : "";
+	description.clear();
+
+	uint8_t* extraData = nullptr;
+	size_t extraSize = 0;
+	if (obs_encoder_get_extra_data(encoder, &extraData, &extraSize))
+		description = ToBase64(extraData, extraSize);
+
+	if (codec == "aac") {
+		// the object type leads the AudioSpecificConfig, AAC-LC without one
+		int objectType = extraData && extraSize ? extraData[0] >> 3 : 2;
+		codec = "mp4a.40." + std::to_string(objectType ? objectType : 2);
+	}
+}
+
+PacketStream::PacketStream(WebSocketServer* server) : server(server) {}
+
+bool PacketStream::Subscribe(const SessionPtr& session) {
+	std::unique_lock<std::mutex> lock(membersMutex);
+	members[SessionRef(session)] = Member();
+	lock.unlock();
+
+	if (tapping)
+		return true;
+
+	core::OutputManager* outputManager = CoreApp->GetOutputManager();
+	tapping = outputManager && outputManager->StartPacketTap(this);
+	if (!tapping) {
+		Unsubscribe(session);
+		return false;
+	}
+
+	// known before any packet arrives, so the first `MediaConfig` describes the audio too
+	audioEncoder = outputManager->PacketTapAudioEncoder();
+
+	return tapping;
+}
+
+void PacketStream::Unsubscribe(const SessionPtr& session) {
+	std::unique_lock<std::mutex> lock(membersMutex);
+	members.erase(SessionRef(session));
+	for (auto it = members.begin(); it != members.end();) {
+		if (it->first.expired())
+			it = members.erase(it);
+		else
+			++it;
+	}
+	bool empty = members.empty();
+	lock.unlock();
+
+	// the tap keeps the recording encoders running, stop it with the last subscriber
+	if (empty && tapping) {
+		core::OutputManager* outputManager = CoreApp->GetOutputManager();
+		if (outputManager)
+			outputManager->StopPacketTap();
+		tapping = false;
+	}
+}
+
+void PacketStream::Stop() {
+	std::unique_lock<std::mutex> lock(membersMutex);
+	members.clear();
+	lock.unlock();
+
+	if (tapping) {
+		core::OutputManager* outputManager = CoreApp->GetOutputManager();
+		if (outputManager)
+			outputManager->StopPacketTap();
+		tapping = false;
+	}
+}
+
+void PacketStream::OnEncodedPacket(struct encoder_packet* packet) {
+	bool video = packet->type == OBS_ENCODER_VIDEO;
+
+	std::vector<SessionPtr> receivers;
+	std::vector<SessionPtr> starting;
+
+	std::unique_lock<std::mutex> lock(membersMutex);
+	for (auto it = members.begin(); it != members.end();) {
+		SessionPtr session = it->first.lock();
+		if (!session) {
+			it = members.erase(it);
+			continue;
+		}
+
+		Member& member = it->second;
+		++it;
+
+		// a decoder cannot skip a delta frame, resync at the next keyframe
+		if (Congested(*session)) {
+			member.waitingKeyframe = true;
+			continue;
+		}
+
+		// `audioEncoder` is set once the tap started, describe the audio from the start
+		if (member.waitingKeyframe) {
+			if (!video || !packet->keyframe || !audioEncoder)
+				continue;
+
+			member.waitingKeyframe = false;
+			starting.push_back(session);
+		}
+
+		receivers.push_back(std::move(session));
+	}
+	lock.unlock();
+
+	if (receivers.empty())
+		return;
+
+	auto contains = [](const std::vector<SessionPtr>& sessions) {
+		return [&sessions](const SessionPtr& session) {
+			return std::find(sessions.begin(), sessions.end(), session) != sessions.end();
+		};
+	};
+
+	// packets go out as replies (topic 0), the slow-consumer policy never drops them
+	if (!starting.empty())
+		server->Broadcast(MakeConfigEvent(packet->encoder, audioEncoder), 0,
+				  contains(starting));
+
+	auto frame = WebSocketServer::MakeSharedFrame(MakeFrame(packet), true);
+	server->BroadcastMedia(frame, 0, contains(receivers));
+}
+
+bool PacketStream::Congested(WebSocketSession& session) {
+	return session.QueuedBytes() > WebSocketBackpressure::maxQueuedBytes / kResyncDivisor ||
+	       session.QueueDepth() > WebSocketBackpressure::maxQueuedMessages / kResyncDivisor;
+}
+
+std::string PacketStream::MakeFrame(const struct encoder_packet* packet) {
+	bool lengthPrefixed = packet->type == OBS_ENCODER_VIDEO && IsAnnexB(packet->encoder);
+
+	std::string payload;
+	// a 3 byte start code grows by one, a handful of units per packet
+	payload.reserve(kHeaderSize + packet->size + (lengthPrefixed ? 16 : 0));
+
+	payload.push_back(char(0xC1));
+	payload.push_back(char(packet->type == OBS_ENCODER_VIDEO ? kFrameTypeVideo
+								 : kFrameTypeAudio));
+	payload.push_back(char(packet->keyframe ? 0x01 : 0x00));
+	payload.push_back(char(packet->track_idx));
+	AppendInt64(payload,
+		    ToMicroseconds(packet->pts, packet->timebase_num, packet->timebase_den));
+	AppendInt64(payload,
+		    ToMicroseconds(packet->dts, packet->timebase_num, packet->timebase_den));
+	if (lengthPrefixed)
+		AppendLengthPrefixed(payload, packet->data, packet->size);
+	else
+		payload.append((const char*)packet->data, packet->size);
+
+	return payload;
+}
+
+Json PacketStream::MakeConfigEvent(obs_encoder_t* video, obs_encoder_t* audio) {
+	std::string codec;
+	std::string description;
+	DescribeVideo(video, codec, description);
+
+	Json::object eventData{
+	  {"video",
+	   Json::object{
+	     {"codec", codec},
+	     {"codedWidth", int(obs_encoder_get_width(video))},
+	     {"codedHeight", int(obs_encoder_get_height(video))},
+	     {"description", description},
+	   }},
+	};
+
+	if (audio) {
+		DescribeAudio(audio, codec, description);
+		eventData["audio"] = Json::object{
+		  {"codec", codec},
+		  {"sampleRate", int(obs_encoder_get_sample_rate(audio))},
+		  {"numberOfChannels", int(audio_output_get_channels(obs_get_audio()))},
+		  {"description", description},
+		};
+	}
+
+	return Json::object{
+	  {"op", WebSocketOpCode::Event},
+	  {"d", Json::object{{"eventType", "MediaConfig"}, {"eventData", eventData}}},
+	};
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include <json11.hpp>
+
+#include "../core/output.h"
+#include "websocket-session.h"
+
+class WebSocketServer;
+
+// Forwards the packets of the recording encoders to the sessions that subscribed to them, so
+// a browser can decode them with WebCodecs without a second encode.
+//
+// A session first receives a `MediaConfig` event whose `video` and `audio` objects are
+// WebCodecs decoder configs: codec strings such as `avc1.64001f` or `mp4a.40.2`, and the
+// `description` in base64 (avcC / hvcC for video, the encoder's extra data for audio). Then
+// binary frames laid out as:
+//
+//   [0xC1] [0x02 video | 0x03 audio] [flags, bit 0: keyframe] [track]
+//   [pts, int64 big endian, microseconds] [dts, int64 big endian, microseconds] [packet data]
+//
+// H.264 and HEVC packet data is converted from Annex B to 4 byte length prefixed NAL units to
+// match the description.
+//
+// New subscribers start at the next keyframe, with a fresh `MediaConfig`. Packets are never
+// dropped by the slow-consumer policy, instead a subscriber whose outbound queue holds more
+// than `1 / kResyncDivisor` of its backpressure limits, in bytes or in messages, skips packets
+// until a keyframe finds it below them again. The rest of the limits leaves room for that
+// keyframe.
+//
+// `Subscribe()`, `Unsubscribe()` and `Stop()` run on the thread the server lives on.
+class PacketStream : public core::EncodedPacketTap {
+public:
+	static constexpr size_t kResyncDivisor = 4;
+
+	static constexpr uint8_t kFrameTypeVideo = 0x02;
+	static constexpr uint8_t kFrameTypeAudio = 0x03;
+	static constexpr size_t kHeaderSize = 20;
+
+	explicit PacketStream(WebSocketServer* server);
+
+	// returns false if the recording encoders could not be started
+	bool Subscribe(const SessionPtr& session);
+	void Unsubscribe(const SessionPtr& session);
+	// drop every subscriber and stop the tap
+	void Stop();
+
+	void OnEncodedPacket(struct encoder_packet* packet) override;
+
+private:
+	typedef std::weak_ptr<WebSocketSession> SessionRef;
+
+	struct Member {
+		bool waitingKeyframe = true;
+	};
+
+	// the session's queue is too full to take more packets
+	static bool Congested(WebSocketSession& session);
+	static std::string MakeFrame(const struct encoder_packet* packet);
+	static json11::Json MakeConfigEvent(obs_encoder_t* video, obs_encoder_t* audio);
+
+	WebSocketServer* server;
+	bool tapping = false;
+	// audio encoder of the tap output, described in `MediaConfig`
+	std::atomic<obs_encoder_t*> audioEncoder = nullptr;
+
+	std::mutex membersMutex;
+	std::map<SessionRef, Member, std::owner_less<SessionRef>> members;
+};
@@ -0,0 +1,681 @@
+#include "request-handler.h"
+
+#include <obs.hpp>
+#include <util/platform.h>
+
+#include "../core/app.h"
+#include "../core/output.h"
+#include "../core/scene-source.h"
+
+#include "stats-stream.h"
+#include "thumbnail-stream.h"
+#include "packet-stream.h"
+#include "event-publisher.h"
+#include "state-sync.h"
+
+using json11::Json;
+
+// Validate `data[key]`, fill `result` and return false if it is missing or of the wrong type
+static bool ValidateField(const Json& data, const char* key, Json::Type type,
+			  RequestResult& result) {
+	const Json& value = data[key];
+	if (value.is_null()) {
+		result = RequestResult::Error(RequestStatus::MissingRequestField,
+					      std::string("Missing field: ") + key);
+		return false;
+	}
+	if (value.type() != type) {
+		result = RequestResult::Error(RequestStatus::InvalidRequestFieldType,
+					      std::string("Invalid type of field: ") + key);
+		return false;
+	}
+	return true;
+}
+
+static core::OutputManager* GetOutputManager(RequestResult& result) {
+	core::OutputManager* outputManager = CoreApp->GetOutputManager();
+	if (!outputManager)
+		result = RequestResult::Error(RequestStatus::GenericError,
+					      "Output manager is not ready");
+	return outputManager;
+}
+
+// Look up the attached source named by `data.sourceName`
+static std::unique_ptr<core::Source> GetSource(const Json& data, RequestResult& result) {
+	if (!ValidateField(data, "sourceName", Json::STRING, result))
+		return nullptr;
+
+	auto source = core::Source::GetAttachedByName(data["sourceName"].string_value());
+	if (!source)
+		result = RequestResult::Error(RequestStatus::ResourceNotFound,
+					      "No attached source with that name");
+	return source;
+}
+
+static inline RequestResult Processed(bool success, const char* comment) {
+	return success ? RequestResult::Ok()
+		       : RequestResult::Error(RequestStatus::RequestProcessingFailed, comment);
+}
+
+RequestHandler::RequestHandler(StatsStream* statsStream, ThumbnailStream* thumbnailStream,
+			       PacketStream* packetStream, EventPublisher* eventPublisher,
+			       StateSync* stateSync)
+  : statsStream(statsStream),
+    thumbnailStream(thumbnailStream),
+    packetStream(packetStream),
+    eventPublisher(eventPublisher),
+    stateSync(stateSync) {
+	sessionHandlers = {
+	  {"GetSessionStats", &RequestHandler::GetSessionStats},
+	  {"GetEventSubscriptions", &RequestHandler::GetEventSubscriptions},
+	  {"SetEventSubscriptions", &RequestHandler::SetEventSubscriptions},
+	  {"SubscribeStats", &RequestHandler::SubscribeStats},
+	  {"UnsubscribeStats", &RequestHandler::UnsubscribeStats},
+	  {"SubscribeThumbnails", &RequestHandler::SubscribeThumbnails},
+	  {"UnsubscribeThumbnails", &RequestHandler::UnsubscribeThumbnails},
+	  {"SubscribePackets", &RequestHandler::SubscribePackets},
+	  {"UnsubscribePackets", &RequestHandler::UnsubscribePackets},
+	  {"SyncState", &RequestHandler::SyncState},
+	};
+
+	handlers = {
+	  {"Echo", &RequestHandler::Echo},
+
+	  {"GetRecordingStatus", &RequestHandler::GetRecordingStatus},
+	  {"StartRecording", &RequestHandler::StartRecording},
+	  {"StopRecording", &RequestHandler::StopRecording},
+	  {"PauseRecording", &RequestHandler::PauseRecording},
+	  {"ResumeRecording", &RequestHandler::ResumeRecording},
+	  {"SetRecordingStandby", &RequestHandler::SetRecordingStandby},
+	  {"GetStandbyCost", &RequestHandler::GetStandbyCost},
+	  {"GetStreamStatus", &RequestHandler::GetStreamStatus},
+	  {"SetStreamAddress", &RequestHandler::SetStreamAddress},
+	  {"StartStream", &RequestHandler::StartStream},
+	  {"StopStream", &RequestHandler::StopStream},
+	  {"SetSharedEncoder", &RequestHandler::SetSharedEncoder},
+	  {"StartVirtualCam", &RequestHandler::StartVirtualCam},
+	  {"StopVirtualCam", &RequestHandler::StopVirtualCam},
+
+	  {"SetRecordingFolder", &RequestHandler::SetRecordingFolder},
+	  {"ChangeVideoContainer", &RequestHandler::ChangeVideoContainer},
+	  {"ChangeVideoEncoder", &RequestHandler::ChangeVideoEncoder},
+	  {"ChangeVideoEncodeQuality", &RequestHandler::ChangeVideoEncodeQuality},
+	  {"SetVideoBitrate", &RequestHandler::SetVideoBitrate},
+	  {"ChangeOutputSize", &RequestHandler::ChangeOutputSize},
+	  {"SaveOutputSettings", &RequestHandler::SaveOutputSettings},
+
+	  {"GetAttachedSources", &RequestHandler::GetAttachedSources},
+	  {"MoveSource", &RequestHandler::MoveSource},
+	  {"ResizeSource", &RequestHandler::ResizeSource},
+	  {"SetSourceHidden", &RequestHandler::SetSourceHidden},
+	  {"BringSourceToFront", &RequestHandler::BringSourceToFront},
+	  {"SendSourceToBack", &RequestHandler::SendSourceToBack},
+	  {"MoveSourceUp", &RequestHandler::MoveSourceUp},
+	  {"MoveSourceDown", &RequestHandler::MoveSourceDown},
+	};
+}
+
+RequestResult RequestHandler::ProcessRequest(const Request& request) {
+	if (request.requestType.empty())
+		return RequestResult::Error(RequestStatus::MissingRequestType,
+					    "Missing request type");
+
+	const Json& data = request.requestData.is_object() ? request.requestData
+							   : Json(Json::object{});
+
+	auto sessionIt = sessionHandlers.find(request.requestType);
+	if (sessionIt != sessionHandlers.end()) {
+		if (!request.session)
+			return RequestResult::Error(RequestStatus::GenericError,
+						    "Request needs a session");
+		return (this->*(sessionIt->second))(request.session, data);
+	}
+
+	auto it = handlers.find(request.requestType);
+	if (it == handlers.end())
+		return RequestResult::Error(RequestStatus::UnknownRequestType,
+					    "Unknown request type: " + request.requestType);
+
+	return (this->*(it->second))(data);
+}
+
+std::vector<RequestResult> RequestHandler::ProcessBatch(const std::vector<Request>& requests,
+							bool haltOnFailure) {
+	std::vector<RequestResult> results;
+	results.reserve(requests.size());
+
+	for (auto& request : requests) {
+		results.push_back(ProcessRequest(request));
+		if (haltOnFailure && results.back().status != RequestStatus::Success)
+			break;
+	}
+
+	return results;
+}
+
+std::string RequestHandler::CoalesceKey(const Request& request) {
+	// the transform setters, a dashboard sends them at mouse rate while dragging
+	if (request.requestType != "MoveSource" && request.requestType != "ResizeSource")
+		return std::string();
+
+	const Json& sourceName = request.requestData["sourceName"];
+	if (!sourceName.is_string())
+		return std::string();
+
+	return request.requestType + '/' + sourceName.string_value();
+}
+
+Json RequestHandler::BuildResponse(const Request& request, const RequestResult& result) {
+	Json::object status = {
+	  {"result", result.status == RequestStatus::Success},
+	  {"code", int(result.status)},
+	};
+	if (!result.comment.empty())
+		status["comment"] = result.comment;
+
+	Json::object response = {
+	  {"requestType", request.requestType},
+	  {"requestId", request.requestId},
+	  {"requestStatus", status},
+	};
+	if (!result.responseData.is_null())
+		response["responseData"] = result.responseData;
+
+	return response;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// outputs
+
+// Answers with its own `requestData`. Goes through the same decode, dispatch and encode path as
+// every other request without touching the core, load generators use it to measure the server.
+RequestResult RequestHandler::Echo(const Json& data) {
+	return RequestResult::Ok(data);
+}
+
+RequestResult RequestHandler::GetRecordingStatus(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	return RequestResult::Ok(Json::object{
+	  {"outputActive", outputManager->RecordingActive()},
+	  {"outputPaused", outputManager->RecordingPaused()},
+	});
+}
+
+RequestResult RequestHandler::StartRecording(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	if (outputManager->RecordingActive())
+		return RequestResult::Error(RequestStatus::OutputRunning,
+					    "Recording is already active");
+
+	return Processed(outputManager->StartRecording(), "Failed to start recording");
+}
+
+RequestResult RequestHandler::StopRecording(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	if (!outputManager->RecordingActive())
+		return RequestResult::Error(RequestStatus::OutputNotRunning,
+					    "Recording is not active");
+
+	outputManager->StopRecording();
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::PauseRecording(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	if (!outputManager->RecordingActive())
+		return RequestResult::Error(RequestStatus::OutputNotRunning,
+					    "Recording is not active");
+
+	if (outputManager->RecordingPaused())
+		return RequestResult::Error(RequestStatus::OutputPaused, "Recording is already paused");
+
+	return Processed(outputManager->PauseRecording(), "Failed to pause recording");
+}
+
+RequestResult RequestHandler::ResumeRecording(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	if (!outputManager->RecordingActive())
+		return RequestResult::Error(RequestStatus::OutputNotRunning,
+					    "Recording is not active");
+
+	if (!outputManager->RecordingPaused())
+		return RequestResult::Error(RequestStatus::OutputNotPaused, "Recording is not paused");
+
+	return Processed(outputManager->ResumeRecording(), "Failed to resume recording");
+}
+
+RequestResult RequestHandler::SetRecordingStandby(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "enabled", Json::BOOL, result))
+		return result;
+
+	outputManager->SetRecordingStandby(data["enabled"].bool_value());
+	return RequestResult::Ok(Json::object{
+	  {"standbyActive", outputManager->RecordingStandbyActive()},
+	});
+}
+
+RequestResult RequestHandler::GetStandbyCost(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	core::StandbyCost cost;
+	outputManager->GetStandbyCost(cost);
+	return RequestResult::Ok(Json::object{
+	  {"standbyActive", cost.active},
+	  {"durationMs", (double)cost.durationMs},
+	  {"encodedFrames", (double)cost.encodedFrames},
+	  {"residentDeltaBytes", (double)cost.residentDeltaBytes},
+	  {"processCpuUsage", cost.processCpuUsage},
+	});
+}
+
+RequestResult RequestHandler::GetStreamStatus(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	return RequestResult::Ok(Json::object{
+	  {"outputActive", outputManager->StreamingActive()},
+	  {"sharedEncoder", outputManager->SharedEncoder()},
+	});
+}
+
+RequestResult RequestHandler::SetStreamAddress(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "address", Json::STRING, result))
+		return result;
+
+	if (outputManager->StreamingActive())
+		return RequestResult::Error(RequestStatus::OutputRunning,
+					    "Streaming is already active");
+
+	return Processed(outputManager->SetStreamAddress(data["address"].string_value(),
+							 data["username"].string_value(),
+							 data["password"].string_value()),
+			 "Failed to set the stream address");
+}
+
+RequestResult RequestHandler::StartStream(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	if (outputManager->StreamingActive())
+		return RequestResult::Error(RequestStatus::OutputRunning,
+					    "Streaming is already active");
+
+	return Processed(outputManager->StartStreaming(), "Failed to start streaming");
+}
+
+RequestResult RequestHandler::StopStream(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	if (!outputManager->StreamingActive())
+		return RequestResult::Error(RequestStatus::OutputNotRunning,
+					    "Streaming is not active");
+
+	outputManager->StopStreaming();
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::SetSharedEncoder(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "shared", Json::BOOL, result))
+		return result;
+
+	if (outputManager->Active())
+		return RequestResult::Error(RequestStatus::OutputRunning, "An output is active");
+
+	if (!outputManager->SetSharedEncoder(data["shared"].bool_value()))
+		return RequestResult::Error(RequestStatus::RequestProcessingFailed,
+					    "Failed to change the shared encoder");
+	return RequestResult::Ok(Json::object{{"sharedEncoder", outputManager->SharedEncoder()}});
+}
+
+RequestResult RequestHandler::StartVirtualCam(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	outputManager->StartVirtualCam();
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::StopVirtualCam(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	outputManager->StopVirtualCam();
+	return RequestResult::Ok();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// output settings
+
+RequestResult RequestHandler::SetRecordingFolder(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "path", Json::STRING, result))
+		return result;
+
+	return Processed(outputManager->SetCurrentRecordingFolder(data["path"].string_value()),
+			 "Failed to set the recording folder");
+}
+
+RequestResult RequestHandler::ChangeVideoContainer(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "container", Json::STRING, result))
+		return result;
+
+	if (!outputManager->ChangeVideoContainer(data["container"].string_value()))
+		return RequestResult::Error(RequestStatus::InvalidRequestField,
+					    "Unsupported container");
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::ChangeVideoEncoder(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "encoder", Json::STRING, result))
+		return result;
+
+	if (!outputManager->ChangeVideoEncoder(data["encoder"].string_value()))
+		return RequestResult::Error(RequestStatus::InvalidRequestField,
+					    "Unsupported encoder");
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::ChangeVideoEncodeQuality(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "quality", Json::STRING, result))
+		return result;
+
+	if (!outputManager->ChangeVideoEncodeQuality(data["quality"].string_value()))
+		return RequestResult::Error(RequestStatus::InvalidRequestField,
+					    "Unsupported quality");
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::SetVideoBitrate(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "bitrate", Json::NUMBER, result))
+		return result;
+
+	int bitrate = data["bitrate"].int_value();
+	if (bitrate <= 0)
+		return RequestResult::Error(RequestStatus::InvalidRequestField,
+					    "Bitrate must be positive");
+
+	outputManager->UpdateVideoRecodeBitrate(uint32_t(bitrate));
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::ChangeOutputSize(const Json& data) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager || !ValidateField(data, "width", Json::NUMBER, result) ||
+	    !ValidateField(data, "height", Json::NUMBER, result))
+		return result;
+
+	int width = data["width"].int_value();
+	int height = data["height"].int_value();
+	if (width <= 0 || height <= 0 ||
+	    !outputManager->ChangeOutputSize(uint32_t(width), uint32_t(height)))
+		return RequestResult::Error(RequestStatus::InvalidRequestField,
+					    "Invalid output size");
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::SaveOutputSettings(const Json&) {
+	RequestResult result;
+	auto outputManager = GetOutputManager(result);
+	if (!outputManager)
+		return result;
+
+	outputManager->SaveOutputSettings();
+	return RequestResult::Ok();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// sources
+
+RequestResult RequestHandler::GetAttachedSources(const Json&) {
+	Json::array sources;
+	for (auto& source : core::Source::GetAttachedSources()) {
+		sources.push_back(Json::object{
+		  {"sourceName", source.Name()},
+		  {"sourceType", int(source.Type())},
+		  {"sourceId", source.ID()},
+		  {"hidden", source.IsHidden()},
+		});
+	}
+
+	return RequestResult::Ok(Json::object{{"sources", sources}});
+}
+
+RequestResult RequestHandler::MoveSource(const Json& data) {
+	RequestResult result;
+	auto source = GetSource(data, result);
+	if (!source || !ValidateField(data, "x", Json::NUMBER, result) ||
+	    !ValidateField(data, "y", Json::NUMBER, result))
+		return result;
+
+	vec2 pos;
+	vec2_set(&pos, float(data["x"].number_value()), float(data["y"].number_value()));
+	return Processed(source->Move(pos), "Failed to move the source");
+}
+
+RequestResult RequestHandler::ResizeSource(const Json& data) {
+	RequestResult result;
+	auto source = GetSource(data, result);
+	if (!source || !ValidateField(data, "scaleX", Json::NUMBER, result) ||
+	    !ValidateField(data, "scaleY", Json::NUMBER, result))
+		return result;
+
+	vec2 scale;
+	vec2_set(&scale, float(data["scaleX"].number_value()),
+		 float(data["scaleY"].number_value()));
+	return Processed(source->Resize(scale), "Failed to resize the source");
+}
+
+RequestResult RequestHandler::SetSourceHidden(const Json& data) {
+	RequestResult result;
+	auto source = GetSource(data, result);
+	if (!source || !ValidateField(data, "hidden", Json::BOOL, result))
+		return result;
+
+	source->SetHidden(data["hidden"].bool_value());
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::BringSourceToFront(const Json& data) {
+	RequestResult result;
+	auto source = GetSource(data, result);
+	if (!source)
+		return result;
+
+	return Processed(source->BringToFront(), "Failed to reorder the source");
+}
+
+RequestResult RequestHandler::SendSourceToBack(const Json& data) {
+	RequestResult result;
+	auto source = GetSource(data, result);
+	if (!source)
+		return result;
+
+	return Processed(source->SendToBack(), "Failed to reorder the source");
+}
+
+RequestResult RequestHandler::MoveSourceUp(const Json& data) {
+	RequestResult result;
+	auto source = GetSource(data, result);
+	if (!source)
+		return result;
+
+	return Processed(source->MoveUp(), "Failed to reorder the source");
+}
+
+RequestResult RequestHandler::MoveSourceDown(const Json& data) {
+	RequestResult result;
+	auto source = GetSource(data, result);
+	if (!source)
+		return result;
+
+	return Processed(source->MoveDown(), "Failed to reorder the source");
+}
+
+RequestResult RequestHandler::GetSessionStats(const SessionPtr& session, const Json&) {
+	return RequestResult::Ok(Json::object{
+	  {"sessionId", (double)session->Id()},
+	  {"incomingMessages", (double)session->IncomingMessages()},
+	  {"outgoingMessages", (double)session->OutgoingMessages()},
+	  {"pendingMessages", (double)session->Executor()->Pending()},
+	  {"queuedMessages", (double)session->QueueDepth()},
+	  {"queuedBytes", (double)session->QueuedBytes()},
+	  {"droppedMessages", (double)session->DroppedMessages()},
+	  {"coalescedMessages", (double)session->CoalescedMessages()},
+	  {"throttledMessages", (double)session->ThrottledMessages()},
+	  {"coalescedRequests", (double)session->CoalescedRequests()},
+	  // sampled around connecting many sessions, gives the memory cost of one
+	  {"processResidentBytes", (double)os_get_proc_resident_size()},
+	});
+}
+
+RequestResult RequestHandler::GetEventSubscriptions(const SessionPtr& session, const Json&) {
+	return RequestResult::Ok(
+	  Json::object{{"eventSubscriptions", (double)session->EventSubscriptions()}});
+}
+
+RequestResult RequestHandler::SetEventSubscriptions(const SessionPtr& session, const Json& data) {
+	RequestResult result;
+	if (!ValidateField(data, "eventSubscriptions", Json::NUMBER, result))
+		return result;
+	if (data["eventSubscriptions"].number_value() < 0)
+		return RequestResult::Error(RequestStatus::InvalidRequestField,
+					    "Event subscriptions must be a bitmask");
+
+	uint32_t mask =
+	  eventPublisher->SetSubscriptions(session, uint32_t(data["eventSubscriptions"].int_value()));
+	return RequestResult::Ok(Json::object{{"eventSubscriptions", (double)mask}});
+}
+
+RequestResult RequestHandler::SubscribeStats(const SessionPtr& session, const Json& data) {
+	uint32_t intervalMs = StatsStream::kDefaultIntervalMs;
+	if (!data["intervalMs"].is_null()) {
+		RequestResult result;
+		if (!ValidateField(data, "intervalMs", Json::NUMBER, result))
+			return result;
+		if (data["intervalMs"].int_value() <= 0)
+			return RequestResult::Error(RequestStatus::InvalidRequestField,
+						    "Interval must be positive");
+		intervalMs = uint32_t(data["intervalMs"].int_value());
+	}
+
+	intervalMs = statsStream->Subscribe(session, intervalMs);
+	return RequestResult::Ok(Json::object{{"intervalMs", int(intervalMs)}});
+}
+
+RequestResult RequestHandler::UnsubscribeStats(const SessionPtr& session, const Json&) {
+	statsStream->Unsubscribe(session);
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::SubscribeThumbnails(const SessionPtr& session, const Json& data) {
+	RequestResult result;
+	double fps = ThumbnailStream::kDefaultFps;
+	uint32_t width = ThumbnailStream::kDefaultWidth;
+
+	if (!data["fps"].is_null()) {
+		if (!ValidateField(data, "fps", Json::NUMBER, result))
+			return result;
+		fps = data["fps"].number_value();
+	}
+	if (!data["width"].is_null()) {
+		if (!ValidateField(data, "width", Json::NUMBER, result))
+			return result;
+		if (data["width"].int_value() <= 0)
+			return RequestResult::Error(RequestStatus::InvalidRequestField,
+						    "Width must be positive");
+		width = uint32_t(data["width"].int_value());
+	}
+	if (!(fps > 0.0))
+		return RequestResult::Error(RequestStatus::InvalidRequestField,
+					    "Fps must be positive");
+
+	thumbnailStream->Subscribe(session, fps, width);
+	return RequestResult::Ok(Json::object{{"fps", fps}, {"width", int(width)}});
+}
+
+RequestResult RequestHandler::UnsubscribeThumbnails(const SessionPtr& session, const Json&) {
+	thumbnailStream->Unsubscribe(session);
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::SubscribePackets(const SessionPtr& session, const Json&) {
+	if (!packetStream->Subscribe(session))
+		return RequestResult::Error(RequestStatus::RequestProcessingFailed,
+					    "Failed to start the recording encoders");
+	return RequestResult::Ok();
+}
+
+RequestResult RequestHandler::UnsubscribePackets(const SessionPtr& session, const Json&) {
+	packetStream->Unsubscribe(session);
+	return RequestResult::Ok();
+}
+
+// A client that reconnects sends the `epoch` and `sequence` of the last state it applied and
+// only receives what changed since, a new client sends neither and gets the full state
+RequestResult RequestHandler::SyncState(const SessionPtr& session, const Json& data) {
+	RequestResult result;
+	if (!data["epoch"].is_null() && !ValidateField(data, "epoch", Json::STRING, result))
+		return result;
+
+	bool hasSequence = !data["sequence"].is_null();
+	if (hasSequence) {
+		if (!ValidateField(data, "sequence", Json::NUMBER, result))
+			return result;
+		if (data["sequence"].number_value() < 0)
+			return RequestResult::Error(RequestStatus::InvalidRequestField,
+						    "Sequence must not be negative");
+	}
+
+	return RequestResult::Ok(stateSync->Sync(session, data["epoch"].string_value(), hasSequence,
+						 uint64_t(data["sequence"].number_value())));
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <json11.hpp>
+
+#include "websocket-session.h"
+
+class StatsStream;
+class ThumbnailStream;
+class PacketStream;
+class EventPublisher;
+class StateSync;
+
+// Status codes reported in `requestStatus.code`
+namespace RequestStatus {
+enum RequestStatus {
+	Unknown = 0,
+	Success = 100,
+	MissingRequestType = 203,
+	UnknownRequestType = 204,
+	GenericError = 205,
+	// rejected by the session's inbound rate limit, nothing was done
+	TooManyRequests = 206,
+	MissingRequestField = 300,
+	InvalidRequestFieldType = 400,
+	InvalidRequestField = 402,
+	OutputRunning = 500,
+	OutputNotRunning = 501,
+	OutputPaused = 502,
+	OutputNotPaused = 503,
+	ResourceNotFound = 600,
+	RequestProcessingFailed = 702,
+};
+} // namespace RequestStatus
+
+struct RequestResult {
+	RequestStatus::RequestStatus status = RequestStatus::Success;
+	std::string comment;
+	json11::Json responseData;
+
+	static RequestResult Ok(json11::Json data = nullptr) {
+		return {RequestStatus::Success, {}, data};
+	}
+	static RequestResult Error(RequestStatus::RequestStatus status, std::string comment) {
+		return {status, std::move(comment), nullptr};
+	}
+};
+
+struct Request {
+	std::string requestType;
+	std::string requestId;
+	json11::Json requestData;
+	// the session that sent the request
+	SessionPtr session;
+};
+
+// Maps `Request`/`RequestBatch` messages onto the core OutputManager and Source APIs.
+// Must run on the UI thread, like the Qt widgets that call the same APIs.
+class RequestHandler {
+public:
+	RequestHandler(StatsStream* statsStream, ThumbnailStream* thumbnailStream,
+		       PacketStream* packetStream, EventPublisher* eventPublisher,
+		       StateSync* stateSync);
+
+	RequestResult ProcessRequest(const Request& request);
+	// run all requests in order, stop at the first failure if `haltOnFailure` is set
+	std::vector<RequestResult> ProcessBatch(const std::vector<Request>& requests,
+						bool haltOnFailure);
+
+	// `d` of a `RequestResponse` or of every entry of `RequestBatchResponse.results`
+	static json11::Json BuildResponse(const Request& request, const RequestResult& result);
+
+	// Key of the target of an idempotent request whose effect is fully replaced by a later
+	// request with the same key, e.g. `MoveSource` of one source. Empty for other requests.
+	static std::string CoalesceKey(const Request& request);
+
+private:
+	typedef RequestResult (RequestHandler::*Handler)(const json11::Json&);
+	// requests that act on the sending session rather than on the app
+	typedef RequestResult (RequestHandler::*SessionHandler)(const SessionPtr&,
+								  const json11::Json&);
+	std::unordered_map<std::string, Handler> handlers;
+	std::unordered_map<std::string, SessionHandler> sessionHandlers;
+
+	StatsStream* statsStream;
+	ThumbnailStream* thumbnailStream;
+	PacketStream* packetStream;
+	EventPublisher* eventPublisher;
+	StateSync* stateSync;
+
+	// session
+	RequestResult GetSessionStats(const SessionPtr& session, const json11::Json& data);
+	RequestResult GetEventSubscriptions(const SessionPtr& session, const json11::Json& data);
+	RequestResult SetEventSubscriptions(const SessionPtr& session, const json11::Json& data);
+	RequestResult SubscribeStats(const SessionPtr& session, const json11::Json& data);
+	RequestResult UnsubscribeStats(const SessionPtr& session, const json11::Json& data);
+	RequestResult SubscribeThumbnails(const SessionPtr& session, const json11::Json& data);
+	RequestResult UnsubscribeThumbnails(const SessionPtr& session, const json11::Json& data);
+	RequestResult SubscribePackets(const SessionPtr& session, const json11::Json& data);
+	RequestResult UnsubscribePackets(const SessionPtr& session, const json11::Json& data);
+	RequestResult SyncState(const SessionPtr& session, const json11::Json& data);
+
+	// general
+	RequestResult Echo(const json11::Json& data);
+
+	// outputs
+	RequestResult GetRecordingStatus(const json11::Json& data);
+	RequestResult StartRecording(const json11::Json& data);
+	RequestResult StopRecording(const json11::Json& data);
+	RequestResult PauseRecording(const json11::Json& data);
+	RequestResult ResumeRecording(const json11::Json& data);
+	RequestResult SetRecordingStandby(const json11::Json& data);
+	RequestResult GetStandbyCost(const json11::Json& data);
+	RequestResult GetStreamStatus(const json11::Json& data);
+	RequestResult SetStreamAddress(const json11::Json& data);
+	RequestResult StartStream(const json11::Json& data);
+	RequestResult StopStream(const json11::Json& data);
+	RequestResult SetSharedEncoder(const json11::Json& data);
+	RequestResult StartVirtualCam(const json11::Json& data);
+	RequestResult StopVirtualCam(const json11::Json& data);
+
+	// output settings
+	RequestResult SetRecordingFolder(const json11::Json& data);
+	RequestResult ChangeVideoContainer(const json11::Json& data);
+	RequestResult ChangeVideoEncoder(const json11::Json& data);
+	RequestResult ChangeVideoEncodeQuality(const json11::Json& data);
+	RequestResult SetVideoBitrate(const json11::Json& data);
+	RequestResult ChangeOutputSize(const json11::Json& data);
+	RequestResult SaveOutputSettings(const json11::Json& data);
+
+	// sources
+	RequestResult GetAttachedSources(const json11::Json& data);
+	RequestResult MoveSource(const json11::Json& data);
+	RequestResult ResizeSource(const json11::Json& data);
+	RequestResult SetSourceHidden(const json11::Json& data);
+	RequestResult BringSourceToFront(const json11::Json& data);
+	RequestResult SendSourceToBack(const json11::Json& data);
+	RequestResult MoveSourceUp(const json11::Json& data);
+	RequestResult MoveSourceDown(const json11::Json& data);
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <functional>
+
+// Runs posted tasks one at a time, in posting order, on a shared worker pool.
+//
+// Producers push into an intrusive lock-free MPSC queue (Vyukov). The first producer that
+// finds the executor idle hands a drain task to the scheduler; that drain is the only
+// consumer until it runs dry, so tasks of one executor never overlap while different
+// executors drain in parallel on the pool.
+class SerialExecutor : public std::enable_shared_from_this<SerialExecutor> {
+public:
+	typedef std::function<void()> Task;
+	typedef std::function<void(Task)> Scheduler;
+
+	// tasks drained before yielding the pool thread to other executors
+	static constexpr size_t kMaxBatch = 64;
+
+	explicit SerialExecutor(Scheduler scheduler)
+	  : scheduler(std::move(scheduler)),
+	    head(&stub),
+	    tail(&stub) {}
+
+	~SerialExecutor() {
+		while (Node* node = Pop()) delete node;
+	}
+
+	SerialExecutor(const SerialExecutor&) = delete;
+	SerialExecutor& operator=(const SerialExecutor&) = delete;
+
+	void Post(Task task) {
+		Node* node = new Node;
+		node->task = std::move(task);
+
+		pending.fetch_add(1, std::memory_order_relaxed);
+		Push(node);
+
+		if (!scheduled.exchange(true, std::memory_order_acq_rel))
+			Schedule();
+	}
+
+	// number of tasks posted but not yet finished
+	size_t Pending() const { return pending.load(std::memory_order_relaxed); }
+
+private:
+	struct Node {
+		std::atomic<Node*> next = nullptr;
+		Task task;
+	};
+
+	void Schedule() {
+		std::shared_ptr<SerialExecutor> self = shared_from_this();
+		scheduler([self]() { self->Drain(); });
+	}
+
+	void Drain() {
+		for (;;) {
+			size_t ran = 0;
+			while (pending.load(std::memory_order_acquire) > 0) {
+				Node* node = Pop();
+				if (!node) {
+					// a producer is between publishing the node and linking it
+					std::this_thread::yield();
+					continue;
+				}
+
+				node->task();
+				delete node;
+				pending.fetch_sub(1, std::memory_order_acq_rel);
+
+				if (++ran == kMaxBatch) {
+					// keep `scheduled` set so no producer starts a second drain
+					Schedule();
+					return;
+				}
+			}
+
+			scheduled.store(false, std::memory_order_seq_cst);
+
+			// a producer may have pushed after the loop saw an empty queue but
+			// before `scheduled` was cleared, it would not have scheduled a drain
+			if (pending.load(std::memory_order_seq_cst) == 0 ||
+			    scheduled.exchange(true, std::memory_order_acq_rel))
+				return;
+		}
+	}
+
+	void Push(Node* node) {
+		node->next.store(nullptr, std::memory_order_relaxed);
+		Node* prev = head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// single consumer only
+	Node* Pop() {
+		Node* first = tail;
+		Node* next = first->next.load(std::memory_order_acquire);
+
+		if (first == &stub) {
+			if (!next)
+				return nullptr;
+			tail = next;
+			first = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (next) {
+			tail = next;
+			return first;
+		}
+
+		if (first != head.load(std::memory_order_acquire))
+			return nullptr;
+
+		Push(&stub);
+
+		next = first->next.load(std::memory_order_acquire);
+		if (next) {
+			tail = next;
+			return first;
+		}
+
+		return nullptr;
+	}
+
+	Scheduler scheduler;
+
+	std::atomic<bool> scheduled = false;
+	std::atomic<size_t> pending = 0;
+
+	Node stub;
+	std::atomic<Node*> head;
+	Node* tail;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <websocketpp/common/connection_hdl.hpp>
+
+#include "websocket-session.h"
+
+typedef uint64_t SessionId;
+
+struct SessionEntry {
+	SessionId id;
+	websocketpp::connection_hdl hdl;
+	SessionPtr session;
+};
+
+// Sessions of a server keyed by a stable integer ID. Readers load an immutable snapshot and
+// never block each other or the writers; sessions are only added and removed on open and
+// close, those copy the snapshot and publish the new one (RCU style). A snapshot keeps its
+// sessions alive for as long as a reader holds it.
+class SessionRegistry {
+public:
+	typedef std::vector<SessionEntry> Snapshot;
+	typedef std::shared_ptr<const Snapshot> SnapshotPtr;
+
+	SessionRegistry() : snapshot(std::make_shared<Snapshot>()) {}
+
+	// register `session`, IDs are never reused
+	SessionId Add(websocketpp::connection_hdl hdl, SessionPtr session) {
+		std::lock_guard<std::mutex> lock(writeMutex);
+
+		SessionId id = nextId++;
+		auto next = std::make_shared<Snapshot>(*Load());
+		// IDs only grow, appending keeps the snapshot sorted
+		next->push_back({id, std::move(hdl), std::move(session)});
+		Publish(std::move(next));
+		return id;
+	}
+
+	// returns the removed session, or nullptr if `id` is unknown
+	SessionPtr Remove(SessionId id) {
+		std::lock_guard<std::mutex> lock(writeMutex);
+
+		SnapshotPtr current = Load();
+		auto it = LowerBound(*current, id);
+		if (it == current->end() || it->id != id)
+			return nullptr;
+
+		SessionPtr session = it->session;
+		auto next = std::make_shared<Snapshot>();
+		next->reserve(current->size() - 1);
+		next->insert(next->end(), current->begin(), it);
+		next->insert(next->end(), it + 1, current->end());
+		Publish(std::move(next));
+		return session;
+	}
+
+	SnapshotPtr Load() const {
+		return std::atomic_load_explicit(&snapshot, std::memory_order_acquire);
+	}
+
+	// copies the entry of `id` into `entry`, returns false if it is unknown
+	bool Find(SessionId id, SessionEntry& entry) const {
+		SnapshotPtr current = Load();
+		auto it = LowerBound(*current, id);
+		if (it == current->end() || it->id != id)
+			return false;
+
+		entry = *it;
+		return true;
+	}
+
+	size_t Size() const { return Load()->size(); }
+
+private:
+	static Snapshot::const_iterator LowerBound(const Snapshot& entries, SessionId id) {
+		return std::lower_bound(
+		  entries.begin(), entries.end(), id,
+		  [](const SessionEntry& entry, SessionId value) { return entry.id < value; });
+	}
+
+	void Publish(SnapshotPtr next) {
+		std::atomic_store_explicit(&snapshot, std::move(next), std::memory_order_release);
+	}
+
+	std::mutex writeMutex;
+	SnapshotPtr snapshot;
+	SessionId nextId = 1;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+
+#include <websocketpp/server.hpp>
+
+#include "websocket-config.h"
+
+// The connection of a session, behind whichever endpoint accepted it. The server reaches
+// connections only through it, so the same code serves plain and TLS sessions. Every call is
+// safe from any thread, a connection that is already gone reports `bad_connection`.
+class SessionTransport {
+public:
+	typedef WebSocketConfig::message_type::ptr Frame;
+
+	virtual ~SessionTransport() {}
+
+	virtual bool Connected() = 0;
+	virtual websocketpp::lib::error_code Send(const Frame& frame) = 0;
+	// bytes handed to websocketpp that are not written to the socket yet
+	virtual size_t BufferedAmount() = 0;
+	virtual void Close(websocketpp::close::status::value code, const std::string& reason,
+			   websocketpp::lib::error_code& errorCode) = 0;
+	virtual void Ping(websocketpp::lib::error_code& errorCode) = 0;
+	virtual void PauseReading(websocketpp::lib::error_code& errorCode) = 0;
+	// drop the socket without a close handshake, done later on the connection's strand
+	// which then reports the close like any other
+	virtual void Terminate() = 0;
+	// whether the connection came through the TLS endpoint
+	virtual bool Secure() const = 0;
+};
+
+template<typename Endpoint> class EndpointTransport : public SessionTransport {
+public:
+	EndpointTransport(Endpoint& endpoint, websocketpp::connection_hdl hdl, bool secure)
+	  : endpoint(endpoint),
+	    hdl(std::move(hdl)),
+	    secure(secure) {}
+
+	bool Connected() override {
+		websocketpp::lib::error_code errorCode;
+		endpoint.get_con_from_hdl(hdl, errorCode);
+		return !errorCode;
+	}
+
+	websocketpp::lib::error_code Send(const Frame& frame) override {
+		websocketpp::lib::error_code errorCode;
+		auto conn = endpoint.get_con_from_hdl(hdl, errorCode);
+		if (errorCode)
+			return errorCode;
+		return conn->send(frame);
+	}
+
+	size_t BufferedAmount() override {
+		websocketpp::lib::error_code errorCode;
+		auto conn = endpoint.get_con_from_hdl(hdl, errorCode);
+		return errorCode ? 0 : conn->get_buffered_amount();
+	}
+
+	void Close(websocketpp::close::status::value code, const std::string& reason,
+		   websocketpp::lib::error_code& errorCode) override {
+		endpoint.close(hdl, code, reason, errorCode);
+	}
+
+	void Ping(websocketpp::lib::error_code& errorCode) override {
+		auto conn = endpoint.get_con_from_hdl(hdl, errorCode);
+		if (!errorCode)
+			conn->ping(std::string(), errorCode);
+	}
+
+	void PauseReading(websocketpp::lib::error_code& errorCode) override {
+		endpoint.pause_reading(hdl, errorCode);
+	}
+
+	void Terminate() override {
+		// the interrupt handler of the endpoint closes the socket
+		websocketpp::lib::error_code errorCode;
+		endpoint.interrupt(hdl, errorCode);
+	}
+
+	bool Secure() const override { return secure; }
+
+private:
+	Endpoint& endpoint;
+	websocketpp::connection_hdl hdl;
+	bool secure;
+};
@@ -0,0 +1,236 @@
+#include <vector>
+
+#include <QDateTime>
+#include <obs.hpp>
+
+#include "../core/app.h"
+#include "../core/output.h"
+
+#include "websocket.h"
+#include "state-sync.h"
+
+using json11::Json;
+
+// private sources and missing config values give null strings
+static const char* NonNull(const char* str) {
+	return str ? str : "";
+}
+
+struct SceneItemsData {
+	Json::object sources;
+	int order = 0;
+};
+
+static bool AddSceneItem(obs_scene_t*, obs_sceneitem_t* item, void* param) {
+	SceneItemsData* data = static_cast<SceneItemsData*>(param);
+	obs_source_t* source = obs_sceneitem_get_source(item);
+
+	vec2 pos;
+	vec2 scale;
+	obs_sceneitem_get_pos(item, &pos);
+	obs_sceneitem_get_scale(item, &scale);
+
+	data->sources[NonNull(obs_source_get_name(source))] = Json::object{
+	  {"sourceId", NonNull(obs_source_get_id(source))},
+	  {"x", pos.x},
+	  {"y", pos.y},
+	  {"scaleX", scale.x},
+	  {"scaleY", scale.y},
+	  {"hidden", !obs_sceneitem_visible(item)},
+	  // bottom to top
+	  {"order", data->order++},
+	};
+	return true;
+}
+
+static bool AddScene(void* param, obs_source_t* source) {
+	Json::object* scenes = static_cast<Json::object*>(param);
+	(*scenes)[NonNull(obs_source_get_name(source))] = Json::object{};
+	return true;
+}
+
+StateSync::StateSync(WebSocketServer* server) : server(server) {
+	timer.setInterval(kPollIntervalMs);
+	QObject::connect(&timer, &QTimer::timeout, [this]() { Tick(); });
+}
+
+Json StateSync::Sync(const SessionPtr& session, const std::string& clientEpoch, bool hasSequence,
+		     uint64_t clientSequence) {
+	if (epoch.empty()) {
+		epoch = QString::number(QDateTime::currentMSecsSinceEpoch(), 36).toStdString();
+		sequence = 0;
+		state = Collect();
+		deltas.clear();
+	} else {
+		// answer with the state as it is now, not as of the previous tick. After an idle
+		// period this records everything that changed meanwhile as one delta.
+		Refresh();
+	}
+
+	members.insert(SessionRef(session));
+	if (!timer.isActive())
+		timer.start();
+
+	Json::object response{
+	  {"epoch", epoch},
+	  {"sequence", (double)sequence},
+	};
+
+	// a client is covered if it saw the state right before the oldest delta or anything after
+	uint64_t oldest = deltas.empty() ? sequence : deltas.front().sequence - 1;
+	if (hasSequence && clientEpoch == epoch && clientSequence >= oldest &&
+	    clientSequence <= sequence) {
+		Json::array missed;
+		for (auto& delta : deltas) {
+			if (delta.sequence > clientSequence)
+				missed.push_back(Json::object{
+				  {"sequence", (double)delta.sequence},
+				  {"changes", delta.changes},
+				});
+		}
+
+		response["full"] = false;
+		response["deltas"] = std::move(missed);
+	} else {
+		response["full"] = true;
+		response["state"] = state;
+	}
+
+	return response;
+}
+
+void StateSync::Unsubscribe(const SessionPtr& session) {
+	members.erase(SessionRef(session));
+	// the model stays, only the polling pauses
+	if (members.empty())
+		timer.stop();
+}
+
+void StateSync::Stop() {
+	timer.stop();
+	epoch.clear();
+	sequence = 0;
+	state = Json();
+	deltas.clear();
+	members.clear();
+}
+
+Json StateSync::Collect() {
+	Json::object scenes;
+	obs_enum_scenes(AddScene, &scenes);
+
+	SceneItemsData items;
+	const char* currentScene = "";
+	OBSScene scene = CoreApp->GetCurrentScene();
+	if (scene) {
+		obs_scene_enum_items(scene, AddSceneItem, &items);
+		currentScene = NonNull(obs_source_get_name(obs_scene_get_source(scene)));
+	}
+
+	core::OutputStatistics stats;
+	bool recordingPaused = false;
+	core::OutputManager* outputManager = CoreApp->GetOutputManager();
+	if (outputManager) {
+		outputManager->GetStatistics(stats);
+		recordingPaused = outputManager->RecordingPaused();
+	}
+
+	auto& config = CoreApp->GetBasicConfig();
+
+	return Json::object{
+	  {"currentScene", currentScene},
+	  {"scenes", std::move(scenes)},
+	  {"sources", std::move(items.sources)},
+	  {"outputs",
+	   Json::object{
+	     {"recording", stats.fileOutput.active},
+	     {"recordingPaused", recordingPaused},
+	     {"streaming", stats.streamOutput.active},
+	     {"replayBuffer", stats.replayBuffer.active},
+	   }},
+	  {"encoder",
+	   Json::object{
+	     {"encoder", NonNull(config_get_string(config, "SimpleOutput", "RecEncoder"))},
+	     {"quality", NonNull(config_get_string(config, "SimpleOutput", "RecQuality"))},
+	     {"container", NonNull(config_get_string(config, "SimpleOutput", "RecFormat2"))},
+	     {"bitrate", (double)config_get_uint(config, "SimpleOutput", "VBitrate")},
+	     {"outputWidth", (double)config_get_uint(config, "Video", "OutputCX")},
+	     {"outputHeight", (double)config_get_uint(config, "Video", "OutputCY")},
+	   }},
+	};
+}
+
+Json::object StateSync::Diff(const Json& prev, const Json& next) {
+	Json::object delta;
+	for (auto& [key, value] : next.object_items()) {
+		const Json& old = prev[key];
+		if (value.is_object() && old.is_object()) {
+			Json::object nested = Diff(old, value);
+			if (!nested.empty())
+				delta.emplace(key, std::move(nested));
+		} else if (value != old) {
+			delta.emplace(key, value);
+		}
+	}
+
+	for (auto& [key, value] : prev.object_items()) {
+		if (next[key].is_null())
+			delta.emplace(key, nullptr);
+	}
+
+	return delta;
+}
+
+void StateSync::Tick() {
+	for (auto it = members.begin(); it != members.end();) {
+		if (it->expired())
+			it = members.erase(it);
+		else
+			++it;
+	}
+
+	// nobody left to sync, don't keep collecting on the UI thread
+	if (members.empty()) {
+		timer.stop();
+		return;
+	}
+
+	Refresh();
+}
+
+void StateSync::Refresh() {
+	Json next = Collect();
+	Json::object changes = Diff(state, next);
+	if (changes.empty())
+		return;
+
+	state = std::move(next);
+	sequence++;
+	deltas.push_back({sequence, changes});
+	if (deltas.size() > kMaxDeltas)
+		deltas.pop_front();
+
+	std::set<WebSocketSession*> receivers;
+	for (auto it = members.begin(); it != members.end();) {
+		SessionPtr session = it->lock();
+		if (!session) {
+			it = members.erase(it);
+			continue;
+		}
+		receivers.insert(session.get());
+		++it;
+	}
+	if (receivers.empty())
+		return;
+
+	// serialized once for every synced session
+	server->Broadcast(EventPublisher::MakeEvent("StateChanged",
+						    {
+						      {"epoch", epoch},
+						      {"sequence", (double)sequence},
+						      {"changes", std::move(changes)},
+						    }),
+			  EventSubscription::State, [&](const SessionPtr& session) {
+				  return receivers.count(session.get()) > 0;
+			  });
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <set>
+#include <deque>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include <QTimer>
+#include <json11.hpp>
+
+#include "websocket-session.h"
+
+class WebSocketServer;
+
+// Versioned model of the state a control client mirrors: scenes, attached sources with their
+// transforms, output states and encoder settings. Sources and scenes are keyed by name so that
+// every change is a JSON merge patch (RFC 7386), removed keys are set to null.
+//
+// The model is refreshed every `kPollIntervalMs`. Each refresh that changed something gets
+// the next sequence number, is kept in a ring of the last `kMaxDeltas` deltas and is sent to
+// the synced sessions as a `StateChanged` event. A client that reconnects with the `epoch` and
+// `sequence` it last saw receives only the deltas it missed, or the full state when they left
+// the ring or the server restarted. Events whose sequence is not above the one of that answer
+// are already included in it.
+//
+// Tracking starts with the first `Sync()` and lasts until `Stop()`, so the ring keeps
+// covering clients while they are away. Polling pauses while no session is synced, the next
+// `Sync()` records what changed meanwhile as one delta. Lives on the thread the server lives on.
+class StateSync {
+public:
+	static constexpr size_t kMaxDeltas = 256;
+	static constexpr int kPollIntervalMs = 250;
+
+	explicit StateSync(WebSocketServer* server);
+
+	// Bring `session` up to date and send it the following deltas as events. Returns the
+	// response data, `hasSequence` is false for clients that never synced.
+	json11::Json Sync(const SessionPtr& session, const std::string& epoch, bool hasSequence,
+			  uint64_t sequence);
+	void Unsubscribe(const SessionPtr& session);
+	// stop tracking and forget the model and its deltas
+	void Stop();
+
+	// the current state, read from the core
+	static json11::Json Collect();
+	// merge patch that turns `prev` into `next`
+	static json11::Json::object Diff(const json11::Json& prev, const json11::Json& next);
+
+private:
+	typedef std::weak_ptr<WebSocketSession> SessionRef;
+
+	struct Delta {
+		uint64_t sequence;
+		json11::Json changes;
+	};
+
+	// poll while a synced session is left
+	void Tick();
+	// collect, diff, record and publish the changes since the previous refresh
+	void Refresh();
+
+	WebSocketServer* server;
+	QTimer timer;
+
+	// identifies this model, sequence numbers of another epoch are meaningless
+	std::string epoch;
+	uint64_t sequence = 0;
+	json11::Json state;
+	std::deque<Delta> deltas;
+
+	std::set<SessionRef, std::owner_less<SessionRef>> members;
+};
@@ -0,0 +1,219 @@
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "../core/app.h"
+#include "../core/output.h"
+
+#include "websocket.h"
+#include "stats-stream.h"
+
+using json11::Json;
+
+static int64_t NowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		 std::chrono::steady_clock::now().time_since_epoch())
+	  .count();
+}
+
+// keep float noise below the display precision from producing deltas
+static double Round2(double value) {
+	return std::round(value * 100.0) / 100.0;
+}
+
+static Json OutputStatsToJson(const core::OutputStats& stats) {
+	return Json::object{
+	  {"active", stats.active},
+	  {"totalFrames", (double)stats.totalFrames},
+	  {"droppedFrames", (double)stats.droppedFrames},
+	  {"totalBytes", (double)stats.totalBytes},
+	  {"congestion", Round2(stats.congestion)},
+	};
+}
+
+StatsStream::StatsStream(WebSocketServer* server) : server(server) {
+	timer.setSingleShot(true);
+	timer.setTimerType(Qt::PreciseTimer);
+	QObject::connect(&timer, &QTimer::timeout, [this]() { Tick(); });
+}
+
+uint32_t StatsStream::Subscribe(const SessionPtr& session, uint32_t intervalMs) {
+	intervalMs = std::clamp(intervalMs, kMinIntervalMs, kMaxIntervalMs);
+
+	Unsubscribe(session);
+
+	auto it = groups.find(intervalMs);
+	if (it == groups.end()) {
+		it = groups.emplace(intervalMs, Group()).first;
+		it->second.intervalMs = intervalMs;
+		it->second.nextDue = NowMs();
+	}
+
+	Member member;
+	member.lost = session->DroppedMessages() + session->CoalescedMessages();
+	it->second.members.emplace(SessionRef(session), member);
+
+	// first event goes out after the reply to the subscribe request
+	timer.start(0);
+	return intervalMs;
+}
+
+void StatsStream::Unsubscribe(const SessionPtr& session) {
+	for (auto it = groups.begin(); it != groups.end();) {
+		it->second.members.erase(SessionRef(session));
+		if (it->second.members.empty())
+			it = groups.erase(it);
+		else
+			++it;
+	}
+
+	if (groups.empty())
+		timer.stop();
+}
+
+Json StatsStream::Collect() {
+	core::OutputStatistics stats;
+	core::OutputManager* outputManager = CoreApp->GetOutputManager();
+	if (outputManager)
+		outputManager->GetStatistics(stats);
+
+	return Json::object{
+	  {"render",
+	   Json::object{
+	     {"activeFps", Round2(stats.activeFps)},
+	     {"averageFrameTimeMs", Round2(stats.averageFrameTimeMs)},
+	     {"renderTotalFrames", (double)stats.renderTotalFrames},
+	     {"renderLaggedFrames", (double)stats.renderLaggedFrames},
+	     {"outputTotalFrames", (double)stats.outputTotalFrames},
+	     {"outputSkippedFrames", (double)stats.outputSkippedFrames},
+	     {"sharedEncoder", stats.sharedEncoder},
+	   }},
+	  {"outputs",
+	   Json::object{
+	     {"fileOutput", OutputStatsToJson(stats.fileOutput)},
+	     {"streamOutput", OutputStatsToJson(stats.streamOutput)},
+	     {"replayBuffer", OutputStatsToJson(stats.replayBuffer)},
+	   }},
+	};
+}
+
+Json::object StatsStream::Diff(const Json& prev, const Json& next) {
+	Json::object delta;
+	for (auto& [key, value] : next.object_items()) {
+		const Json& old = prev[key];
+		if (value.is_object() && old.is_object()) {
+			Json::object nested = Diff(old, value);
+			if (!nested.empty())
+				delta.emplace(key, std::move(nested));
+		} else if (value != old) {
+			delta.emplace(key, value);
+		}
+	}
+	return delta;
+}
+
+void StatsStream::Tick() {
+	int64_t now = NowMs();
+	int64_t nextDue = INT64_MAX;
+	Json stats;
+
+	for (auto& [intervalMs, group] : groups) {
+		if (group.nextDue <= now) {
+			// collect at most once per tick, however many groups are due
+			if (stats.is_null())
+				stats = Collect();
+
+			Publish(group, stats);
+
+			// skip ticks that were missed instead of bursting to catch up
+			group.nextDue += intervalMs;
+			if (group.nextDue <= now)
+				group.nextDue = now + intervalMs;
+		}
+
+		nextDue = std::min(nextDue, group.nextDue);
+	}
+
+	if (groups.empty())
+		timer.stop();
+	else
+		timer.start(int(std::max<int64_t>(nextDue - now, 0)));
+}
+
+void StatsStream::Publish(Group& group, const Json& stats) {
+	std::vector<std::pair<SessionPtr, Member*>> alive;
+	std::set<WebSocketSession*> fullReceivers;
+	std::set<WebSocketSession*> deltaReceivers;
+
+	for (auto it = group.members.begin(); it != group.members.end();) {
+		SessionPtr session = it->first.lock();
+		if (!session) {
+			it = group.members.erase(it);
+			continue;
+		}
+
+		// a dropped or coalesced message may have been one of ours, resend everything
+		Member& member = it->second;
+		uint64_t lost = session->DroppedMessages() + session->CoalescedMessages();
+		if (lost != member.lost)
+			member.needsFull = true;
+		member.lost = lost;
+
+		if (member.needsFull)
+			fullReceivers.insert(session.get());
+		else
+			deltaReceivers.insert(session.get());
+
+		alive.emplace_back(std::move(session), &member);
+		++it;
+	}
+
+	Json::object delta = Diff(group.last, stats);
+	if (delta.empty() && fullReceivers.empty())
+		return;
+
+	// the sequence only moves when the state does, a gap means the client missed an event
+	if (!delta.empty()) {
+		group.sequence++;
+		group.last = stats;
+	}
+
+	if (!fullReceivers.empty()) {
+		server->Broadcast(MakeEvent(group, true, stats.object_items()),
+				  EventSubscription::Stats, [&](const SessionPtr& session) {
+					  return fullReceivers.count(session.get()) > 0;
+				  });
+	}
+	if (!delta.empty() && !deltaReceivers.empty()) {
+		server->Broadcast(MakeEvent(group, false, std::move(delta)),
+				  EventSubscription::Stats, [&](const SessionPtr& session) {
+					  return deltaReceivers.count(session.get()) > 0;
+				  });
+	}
+
+	// losses caused by queueing this tick's event are caught on the next one
+	for (auto& [session, member] : alive) {
+		uint64_t lost = session->DroppedMessages() + session->CoalescedMessages();
+		member->needsFull = lost != member->lost;
+		member->lost = lost;
+	}
+}
+
+Json StatsStream::MakeEvent(const Group& group, bool full, Json::object stats) {
+	return Json::object{
+	  {"op", WebSocketOpCode::Event},
+	  {"d",
+	   Json::object{
+	     {"eventType", "StatsUpdated"},
+	     {"eventData",
+	      Json::object{
+		{"intervalMs", (int)group.intervalMs},
+		{"sequence", (double)group.sequence},
+		{"full", full},
+		{"stats", std::move(stats)},
+	      }},
+	   }},
+	};
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <memory>
+#include <cstdint>
+
+#include <QTimer>
+#include <json11.hpp>
+
+#include "websocket-session.h"
+
+class WebSocketServer;
+
+// Periodic `StatsUpdated` events for the sessions that subscribed to them. Sessions asking for
+// the same interval share one stream: the stats are collected and diffed once per tick and the
+// delta is serialized once for all of them. Every event carries a sequence number, the first
+// one a session receives and any after one of its messages was dropped carry the full state.
+//
+// Lives on the thread the server lives on, like `RequestHandler`.
+class StatsStream {
+public:
+	static constexpr uint32_t kDefaultIntervalMs = 1000;
+	static constexpr uint32_t kMinIntervalMs = 100;
+	static constexpr uint32_t kMaxIntervalMs = 60000;
+
+	explicit StatsStream(WebSocketServer* server);
+
+	// (re)subscribe `session`, returns the interval actually used
+	uint32_t Subscribe(const SessionPtr& session, uint32_t intervalMs);
+	void Unsubscribe(const SessionPtr& session);
+
+	// json form of the current `core::OutputStatistics`
+	static json11::Json Collect();
+	// fields of `next` that differ from `prev`, nested objects are diffed recursively and left
+	// out when nothing in them changed
+	static json11::Json::object Diff(const json11::Json& prev, const json11::Json& next);
+
+private:
+	typedef std::weak_ptr<WebSocketSession> SessionRef;
+
+	struct Member {
+		// `DroppedMessages() + CoalescedMessages()` of the session at the previous tick
+		uint64_t lost = 0;
+		bool needsFull = true;
+	};
+
+	struct Group {
+		uint32_t intervalMs;
+		int64_t nextDue = 0;
+		uint64_t sequence = 0;
+		json11::Json last;
+		std::map<SessionRef, Member, std::owner_less<SessionRef>> members;
+	};
+
+	void Tick();
+	void Publish(Group& group, const json11::Json& stats);
+	json11::Json MakeEvent(const Group& group, bool full, json11::Json::object stats);
+
+	WebSocketServer* server;
+	QTimer timer;
+	std::map<uint32_t, Group> groups;
+};
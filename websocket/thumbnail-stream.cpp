@@ -0,0 +1,186 @@
+#include <cmath>
+#include <algorithm>
+
+#include <QImage>
+#include <QBuffer>
+#include <QByteArray>
+#include <util/platform.h>
+
+#include "websocket.h"
+#include "thumbnail-stream.h"
+
+static int64_t NowMs() {
+	return int64_t(os_gettime_ns() / 1000000);
+}
+
+ThumbnailStream::ThumbnailStream(WebSocketServer* server) : server(server) {
+	// one frame in flight at a time, see `encoding`
+	encoderPool.setMaxThreadCount(1);
+}
+
+ThumbnailStream::~ThumbnailStream() {
+	RemoveTap();
+	encoderPool.waitForDone();
+}
+
+void ThumbnailStream::Subscribe(const SessionPtr& session, double& fps, uint32_t& width) {
+	fps = std::clamp(fps, kMinFps, kMaxFps);
+	width = std::clamp(width, kMinWidth, kMaxWidth);
+
+	std::unique_lock<std::mutex> lock(membersMutex);
+	members[SessionRef(session)] = Member{int64_t(std::lround(1000.0 / fps)), width};
+	lock.unlock();
+
+	UpdateTap();
+}
+
+void ThumbnailStream::Unsubscribe(const SessionPtr& session) {
+	std::unique_lock<std::mutex> lock(membersMutex);
+	members.erase(SessionRef(session));
+	lock.unlock();
+
+	UpdateTap();
+}
+
+void ThumbnailStream::Stop() {
+	std::unique_lock<std::mutex> lock(membersMutex);
+	members.clear();
+	lock.unlock();
+
+	RemoveTap();
+	encoderPool.waitForDone();
+}
+
+void ThumbnailStream::UpdateTap() {
+	double fps = 0.0;
+	uint32_t width = 0;
+
+	std::unique_lock<std::mutex> lock(membersMutex);
+	for (auto it = members.begin(); it != members.end();) {
+		if (it->first.expired()) {
+			it = members.erase(it);
+			continue;
+		}
+
+		fps = std::max(fps, 1000.0 / double(it->second.intervalMs));
+		width = std::max(width, it->second.width);
+		++it;
+	}
+	lock.unlock();
+
+	obs_video_info ovi;
+	if (width == 0 || !obs_get_video_info(&ovi) || !ovi.output_width || !ovi.output_height) {
+		RemoveTap();
+		return;
+	}
+
+	// libobs scales and converts on the video thread, only every `divisor`-th frame
+	double baseFps = double(ovi.fps_num) / double(ovi.fps_den);
+	uint32_t divisor = std::max<uint32_t>(1, uint32_t(std::lround(baseFps / fps)));
+
+	width = std::min(width, ovi.output_width) & ~1u;
+	uint32_t height = uint32_t(std::lround(double(width) * ovi.output_height /
+						 ovi.output_width)) &
+			  ~1u;
+
+	if (tapped && tapWidth == width && tapHeight == height && tapDivisor == divisor)
+		return;
+
+	RemoveTap();
+
+	tapWidth = width;
+	tapHeight = height;
+	tapDivisor = divisor;
+	tapIntervalMs = std::lround(1000.0 * divisor / baseFps);
+
+	video_scale_info conversion = {};
+	conversion.format = VIDEO_FORMAT_RGBA;
+	conversion.width = width;
+	conversion.height = height;
+	conversion.range = VIDEO_RANGE_FULL;
+	conversion.colorspace = ovi.colorspace;
+
+	obs_add_raw_video_callback2(&conversion, divisor, ThumbnailStream::OnRawVideo, this);
+	tapped = true;
+
+	blog(LOG_INFO, "[ThumbnailStream::UpdateTap] Tapping program output at %ux%u, %.2f fps",
+	     width, height, baseFps / divisor);
+}
+
+void ThumbnailStream::RemoveTap() {
+	if (!tapped)
+		return;
+
+	// returns once the callback is not running anymore
+	obs_remove_raw_video_callback(ThumbnailStream::OnRawVideo, this);
+	tapped = false;
+}
+
+void ThumbnailStream::OnRawVideo(void* param, struct video_data* frame) {
+	auto stream = static_cast<ThumbnailStream*>(param);
+
+	// never queue behind a frame that is still being encoded
+	if (stream->encoding) {
+		stream->skippedFrames++;
+		return;
+	}
+
+	int64_t now = NowMs();
+
+	// pick the sessions that are due and keep up, others skip this frame
+	std::vector<SessionPtr> receivers;
+	std::unique_lock<std::mutex> lock(stream->membersMutex);
+	for (auto& [ref, member] : stream->members) {
+		if (now < member.nextDue)
+			continue;
+
+		SessionPtr session = ref.lock();
+		if (!session || session->QueueDepth() > 0)
+			continue;
+
+		// half a tap interval of slack so a rate equal to the tap's never misses a frame
+		member.nextDue = now + member.intervalMs - stream->tapIntervalMs / 2;
+		receivers.push_back(std::move(session));
+	}
+	lock.unlock();
+
+	if (receivers.empty())
+		return;
+
+	// only this thread sets it, the encoder clears it when done
+	stream->encoding = true;
+
+	QImage image = QImage(frame->data[0], int(stream->tapWidth), int(stream->tapHeight),
+			      int(frame->linesize[0]), QImage::Format_RGBA8888)
+			 .copy();
+
+	stream->encoderPool.start(compat::CreateFunctionRunnable(
+	  [stream, image = std::move(image), receivers = std::move(receivers)]() {
+		  QByteArray jpeg;
+		  QBuffer buffer(&jpeg);
+		  buffer.open(QIODevice::WriteOnly);
+		  // drop the alpha channel, JPEG has none
+		  image.convertToFormat(QImage::Format_RGB888).save(&buffer, "JPG", kJpegQuality);
+
+		  uint32_t sequence = ++stream->sequence;
+		  std::string payload;
+		  payload.reserve(6 + size_t(jpeg.size()));
+		  payload.push_back(char(kFrameMarker));
+		  payload.push_back(char(kFrameTypeJpeg));
+		  for (int shift = 24; shift >= 0; shift -= 8)
+			  payload.push_back(char((sequence >> shift) & 0xff));
+		  payload.append(jpeg.constData(), size_t(jpeg.size()));
+
+		  stream->Send(payload, receivers);
+		  stream->encoding = false;
+	  }));
+}
+
+void ThumbnailStream::Send(const std::string& payload, const std::vector<SessionPtr>& receivers) {
+	auto frame = WebSocketServer::MakeSharedFrame(payload, true);
+	server->BroadcastMedia(frame, EventSubscription::Thumbnails,
+			       [&receivers](const SessionPtr& session) {
+				       return std::find(receivers.begin(), receivers.end(),
+							session) != receivers.end();
+			       });
+}
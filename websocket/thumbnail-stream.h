@@ -0,0 +1,90 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include <QThreadPool>
+#include <obs.h>
+
+#include "websocket-session.h"
+
+class WebSocketServer;
+
+// Low-rate JPEG thumbnails of the program output for the sessions that subscribed to them.
+//
+// One raw video tap is shared by every subscriber, libobs scales and converts the frames to
+// RGBA at the highest requested rate and width. Frames are JPEG-encoded on a worker thread and
+// sent as binary frames laid out as:
+//
+//   [0xC1] [0x01] [sequence, uint32 big endian] [JPEG data]
+//
+// 0xC1 is never used by MsgPack, so MsgPack sessions can tell thumbnails from messages by the
+// first byte. A new frame is skipped while the previous one is still being encoded, and a
+// session whose outbound queue is not empty skips frames instead of queueing them.
+//
+// `Subscribe()` and `Unsubscribe()` run on the thread the server lives on.
+class ThumbnailStream {
+public:
+	static constexpr double kDefaultFps = 1.0;
+	static constexpr double kMinFps = 0.2;
+	static constexpr double kMaxFps = 5.0;
+	static constexpr uint32_t kDefaultWidth = 320;
+	static constexpr uint32_t kMinWidth = 64;
+	static constexpr uint32_t kMaxWidth = 640;
+	static constexpr int kJpegQuality = 70;
+
+	// first bytes of every thumbnail frame
+	static constexpr uint8_t kFrameMarker = 0xC1;
+	static constexpr uint8_t kFrameTypeJpeg = 0x01;
+
+	explicit ThumbnailStream(WebSocketServer* server);
+	~ThumbnailStream();
+
+	// (re)subscribe `session`, clamps `fps` and `width` to the supported range
+	void Subscribe(const SessionPtr& session, double& fps, uint32_t& width);
+	void Unsubscribe(const SessionPtr& session);
+	// drop every subscriber, remove the tap and wait for the frame being encoded
+	void Stop();
+
+	// frames skipped because the previous one was still being encoded
+	uint64_t SkippedFrames() const { return skippedFrames; }
+
+private:
+	typedef std::weak_ptr<WebSocketSession> SessionRef;
+
+	struct Member {
+		int64_t intervalMs;
+		uint32_t width;
+		int64_t nextDue = 0;
+	};
+
+	// runs on the libobs video thread
+	static void OnRawVideo(void* param, struct video_data* frame);
+	void Send(const std::string& payload, const std::vector<SessionPtr>& receivers);
+
+	// adds, moves or removes the raw video tap to match the subscribers
+	void UpdateTap();
+	void RemoveTap();
+
+	WebSocketServer* server;
+
+	std::mutex membersMutex;
+	std::map<SessionRef, Member, std::owner_less<SessionRef>> members;
+
+	// only changed while no tap is installed
+	bool tapped = false;
+	uint32_t tapWidth = 0;
+	uint32_t tapHeight = 0;
+	uint32_t tapDivisor = 0;
+	int64_t tapIntervalMs = 0;
+
+	QThreadPool encoderPool;
+	std::atomic<bool> encoding = false;
+	std::atomic<uint32_t> sequence = 0;
+	std::atomic<uint64_t> skippedFrames = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <mutex>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+// Hierarchical timer wheel with two levels: `kSlots` slots of one tick each, then `kSlots`
+// slots of `kSlots` ticks each. Deadlines further out are parked in the last slot of the outer
+// level and re-sorted when it comes around. Scheduling and expiring are O(1) per timer
+// whatever the number of timers, so thousands of sessions cost one periodic tick.
+//
+// Timers can not be cancelled, the callback of an expired key is expected to check whether
+// the key is still alive and to schedule it again if needed. Thread-safe.
+template<typename Key> class TimerWheel {
+public:
+	static constexpr uint64_t kSlots = 64;
+
+	// fire `key` once `tick` has been reached by `Advance()`, a past tick fires on the next one
+	void Schedule(Key key, uint64_t tick) {
+		std::lock_guard<std::mutex> lock(mutex);
+		Insert({std::move(key), tick});
+	}
+
+	// move the wheel to `tick` and return the keys whose deadline passed, oldest first
+	std::vector<Key> Advance(uint64_t tick) {
+		std::vector<Key> expired;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		while (current < tick) {
+			current++;
+
+			// pull the outer slot that starts at this tick down to the inner level
+			if (current % kSlots == 0) {
+				auto& outerSlot = outer[(current / kSlots) % kSlots];
+				std::vector<Entry> entries;
+				entries.swap(outerSlot);
+				for (auto& entry : entries) {
+					if (entry.tick <= current)
+						inner[current % kSlots].push_back(std::move(entry));
+					else
+						Insert(std::move(entry));
+				}
+			}
+
+			auto& slot = inner[current % kSlots];
+			for (auto& entry : slot)
+				expired.push_back(std::move(entry.key));
+			slot.clear();
+		}
+
+		return expired;
+	}
+
+	uint64_t CurrentTick() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return current;
+	}
+
+	// drop every timer and restart at tick 0
+	void Reset() {
+		std::lock_guard<std::mutex> lock(mutex);
+		current = 0;
+		for (auto& slot : inner)
+			slot.clear();
+		for (auto& slot : outer)
+			slot.clear();
+	}
+
+private:
+	struct Entry {
+		Key key;
+		uint64_t tick;
+	};
+
+	void Insert(Entry entry) {
+		if (entry.tick <= current)
+			entry.tick = current + 1;
+
+		uint64_t delta = entry.tick - current;
+		// the inner slot of `tick` is still ahead when it is in the current inner round
+		if (delta < kSlots && entry.tick / kSlots == current / kSlots) {
+			inner[entry.tick % kSlots].push_back(std::move(entry));
+		} else if (entry.tick / kSlots - current / kSlots < kSlots) {
+			outer[(entry.tick / kSlots) % kSlots].push_back(std::move(entry));
+		} else {
+			// too far out, park it in the last outer slot of this round and re-sort it then
+			outer[(current / kSlots + kSlots - 1) % kSlots].push_back(std::move(entry));
+		}
+	}
+
+	std::mutex mutex;
+	uint64_t current = 0;
+	std::array<std::vector<Entry>, kSlots> inner;
+	std::array<std::vector<Entry>, kSlots> outer;
+};
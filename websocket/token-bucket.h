@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// Classic token bucket: `burst` tokens at most, refilled at `ratePerSecond`. Not thread-safe,
+// a session only touches its bucket from its serial executor.
+class TokenBucket {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// take one token, returns false if the bucket is empty. A rate of 0 disables the limit.
+	bool TryTake(double ratePerSecond, double burst, Clock::time_point now = Clock::now()) {
+		if (ratePerSecond <= 0.0)
+			return true;
+
+		if (!started) {
+			tokens = burst;
+			last = now;
+			started = true;
+		} else {
+			double elapsed = std::chrono::duration<double>(now - last).count();
+			tokens = std::min(burst, tokens + elapsed * ratePerSecond);
+			last = now;
+		}
+
+		if (tokens < 1.0)
+			return false;
+
+		tokens -= 1.0;
+		return true;
+	}
+
+private:
+	bool started = false;
+	double tokens = 0.0;
+	Clock::time_point last;
+};
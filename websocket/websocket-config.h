@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+
+#include "outbound-queue.h"
+
+// permessage-deflate settings, read by every new connection during its handshake
+struct WebSocketCompression {
+	// offer compression to clients that ask for it
+	static inline std::atomic<bool> enabled = true;
+	// messages smaller than this are always sent uncompressed
+	static inline std::atomic<size_t> threshold = 1024;
+	// keep the LZ77 window between messages, better ratio but the zlib state of every
+	// session stays warm for its whole lifetime
+	static inline std::atomic<bool> contextTakeover = false;
+	// server LZ77 window (9 ~ 15), zlib needs about (1 << (bits + 2)) + 128KiB per session
+	static inline std::atomic<uint8_t> windowBits = 11;
+};
+
+// per-session outbound limits, applied on every queued message
+struct WebSocketBackpressure {
+	static inline std::atomic<size_t> maxQueuedBytes = 8 * 1024 * 1024;
+	static inline std::atomic<size_t> maxQueuedMessages = 2048;
+	static inline std::atomic<SlowConsumerPolicy> policy = SlowConsumerPolicy::DropOldest;
+	// bytes handed to websocketpp that may still be unwritten before a session queues locally
+	static inline std::atomic<size_t> inFlightBytes = 256 * 1024;
+	// how long to wait before retrying a session whose socket is still busy
+	static inline std::atomic<long> retryMs = 5;
+};
+
+// per-session inbound limits, a token bucket checked for every incoming message
+struct WebSocketRateLimit {
+	// sustained messages per second, 0 disables the limit
+	static inline std::atomic<double> messagesPerSecond = 100.0;
+	// messages a session may send at once after being idle
+	static inline std::atomic<double> burst = 200.0;
+};
+
+// liveness checks, driven by one timer wheel for all sessions, read when the server starts
+struct WebSocketHeartbeat {
+	// a session that sent nothing for this long is pinged, pongs count as activity
+	static inline std::atomic<long> pingIntervalMs = 10000;
+	// a session that stayed silent this long is closed
+	static inline std::atomic<long> idleTimeoutMs = 30000;
+	// resolution of the timer wheel
+	static inline std::atomic<long> tickMs = 500;
+};
+
+class WebSocketSession;
+
+// data websocketpp keeps inside every connection, handlers running on the connection's strand
+// reach their session through it without touching the session registry
+struct WebSocketConnectionBase {
+	std::shared_ptr<WebSocketSession> session;
+};
+
+template<typename config>
+class WebSocketDeflate : public websocketpp::extensions::permessage_deflate::enabled<config> {
+	typedef websocketpp::extensions::permessage_deflate::enabled<config> base;
+
+public:
+	WebSocketDeflate() {
+		namespace pmd = websocketpp::extensions::permessage_deflate;
+
+		if (!WebSocketCompression::contextTakeover)
+			this->enable_server_no_context_takeover();
+
+		uint8_t bits = WebSocketCompression::windowBits;
+		this->set_server_max_window_bits(bits < 9 ? 9 : (bits > 15 ? 15 : bits),
+						 pmd::mode::smallest);
+	}
+
+	// hides `enabled::negotiate`, the processor calls it on the concrete type
+	std::pair<websocketpp::lib::error_code, std::string>
+	negotiate(websocketpp::http::attribute_list const& offer) {
+		namespace pmd = websocketpp::extensions::permessage_deflate;
+
+		if (!WebSocketCompression::enabled)
+			return {pmd::error::make_error_code(pmd::error::general), std::string()};
+
+		return base::negotiate(offer);
+	}
+};
+
+// `Base` (`websocketpp::config::asio` or `asio_tls`) plus the permessage-deflate extension.
+// Multithreading stays enabled so every connection gets its own strand on the shared
+// io_context. Both endpoints use the same message type, so a frame built once can be sent by
+// either.
+template<typename Base> struct WebSocketEndpointConfig : public Base {
+	typedef WebSocketEndpointConfig type;
+	typedef Base base;
+
+	typedef typename base::concurrency_type concurrency_type;
+	typedef typename base::request_type request_type;
+	typedef typename base::response_type response_type;
+	typedef typename base::message_type message_type;
+	typedef typename base::con_msg_manager_type con_msg_manager_type;
+	typedef typename base::endpoint_msg_manager_type endpoint_msg_manager_type;
+	typedef typename base::alog_type alog_type;
+	typedef typename base::elog_type elog_type;
+	typedef typename base::rng_type rng_type;
+
+	typedef WebSocketConnectionBase connection_base;
+
+	static bool const enable_multithreading = true;
+
+	// inherits the socket type, plain or TLS, from `Base`
+	struct transport_config : public base::transport_config {
+		typedef typename base::concurrency_type concurrency_type;
+		typedef typename base::alog_type alog_type;
+		typedef typename base::elog_type elog_type;
+		typedef typename base::request_type request_type;
+		typedef typename base::response_type response_type;
+
+		static bool const enable_multithreading = true;
+	};
+
+	typedef websocketpp::transport::asio::endpoint<transport_config> transport_type;
+
+	struct permessage_deflate_config {};
+	typedef WebSocketDeflate<permessage_deflate_config> permessage_deflate_type;
+};
+
+typedef WebSocketEndpointConfig<websocketpp::config::asio> WebSocketConfig;
+typedef WebSocketEndpointConfig<websocketpp::config::asio_tls> WebSocketTlsConfig;
@@ -5,11 +5,41 @@
 #include <atomic>
 #include <memory>
 
+#include "serial-executor.h"
+#include "token-bucket.h"
+#include "websocket-config.h"
+#include "session-transport.h"
+
+// topics of broadcast events, see `WebSocketSession::EventSubscriptions`
+namespace EventSubscription {
+enum EventSubscription : uint32_t {
+	Stats = 1 << 0,
+	Thumbnails = 1 << 1,
+	Recording = 1 << 2,
+	Scenes = 1 << 3,
+	Sources = 1 << 4,
+	// every log line, high volume so only sent to sessions that ask for it
+	Logs = 1 << 5,
+	// `StateChanged` deltas for sessions that synced their state
+	State = 1 << 6,
+	Streaming = 1 << 7,
+
+	All = Stats | Thumbnails | Recording | Scenes | Sources | Logs | State | Streaming,
+	Default = All & ~Logs,
+	// events that carry the full current value, a newer one may replace a queued one
+	Snapshots = Stats | Thumbnails,
+};
+} // namespace EventSubscription
+
 class WebSocketSession;
 typedef std::shared_ptr<WebSocketSession> SessionPtr;
+typedef OutboundQueue<WebSocketConfig::message_type::ptr> SessionOutboundQueue;
 
 class WebSocketSession {
 public:
+	explicit WebSocketSession(SerialExecutor::Scheduler scheduler)
+	  : executor(std::make_shared<SerialExecutor>(std::move(scheduler))) {}
+
 	inline std::string RemoteAddress() {
 		std::lock_guard<std::mutex> lock(remoteAddressMutex);
 		return remoteAddress;
@@ -19,25 +49,79 @@ public:
 		remoteAddress = address;
 	}
 
+	// set once before the session is registered
+	inline SessionTransport* Transport() { return transport.get(); }
+	inline void SetTransport(std::unique_ptr<SessionTransport> value) {
+		transport = std::move(value);
+	}
+
+	// stable ID in the server's session registry, never reused
+	inline uint64_t Id() { return id; }
+	inline void SetId(uint64_t value) { id = value; }
+
 	inline uint64_t ConnectedAt() { return connectedAt; }
 	inline void SetConnectedAt(uint64_t at) { connectedAt = at; }
 
+	// steady clock milliseconds of the last message or pong received from the client
+	inline int64_t LastActivity() { return lastActivity; }
+	inline void Touch(int64_t nowMs) { lastActivity.store(nowMs, std::memory_order_relaxed); }
+
 	inline uint64_t IncomingMessages() { return incomingMessages; }
 	inline void IncrementIncomingMessages() { incomingMessages++; }
 
 	inline uint64_t OutgoingMessages() { return outgoingMessages; }
 	inline void IncrementOutgoingMessages() { outgoingMessages++; }
 
+	// messages waiting for the socket and their total size
+	inline size_t QueueDepth() { return outbound.Depth(); }
+	inline size_t QueuedBytes() { return outbound.Bytes(); }
+	// messages dropped or replaced by the slow-consumer policy
+	inline uint64_t DroppedMessages() { return outbound.Dropped(); }
+	inline uint64_t CoalescedMessages() { return outbound.Coalesced(); }
+
+	inline SessionOutboundQueue& Outbound() { return outbound; }
+
+	// only used from the session executor
+	inline TokenBucket& InboundBucket() { return inboundBucket; }
+	// incoming messages rejected by the rate limit
+	inline uint64_t ThrottledMessages() { return throttledMessages; }
+	inline void IncrementThrottledMessages() { throttledMessages++; }
+	// requests superseded by a later one for the same target before they ran
+	inline uint64_t CoalescedRequests() { return coalescedRequests; }
+	inline void IncrementCoalescedRequests() { coalescedRequests++; }
+
+	// bitmask of event topics the session wants to receive through broadcasts
+	inline uint32_t EventSubscriptions() { return eventSubscriptions; }
+	inline void SetEventSubscriptions(uint32_t mask) { eventSubscriptions = mask; }
+
+	// whether permessage-deflate was negotiated during the handshake
+	inline bool CompressionEnabled() { return compressionEnabled; }
+	inline void SetCompressionEnabled(bool enabled) { compressionEnabled = enabled; }
+
+	// a `WebSocketEncoding`, negotiated once during the handshake
 	inline uint8_t Encoding() { return encoding; }
-	inline void SetEncoding(uint8_t encoding) { encoding = encoding; }
+	inline void SetEncoding(uint8_t value) { encoding = value; }
+
+	// processes this session's incoming messages in arrival order
+	inline SerialExecutor* Executor() { return executor.get(); }
 
 	std::mutex OperationMutex;
 
 private:
 	std::mutex remoteAddressMutex;
 	std::string remoteAddress;
+	std::atomic<uint64_t> id = 0;
 	std::atomic<uint64_t> connectedAt = 0;
+	std::atomic<int64_t> lastActivity = 0;
 	std::atomic<uint64_t> incomingMessages = 0;
 	std::atomic<uint64_t> outgoingMessages = 0;
+	std::atomic<uint64_t> throttledMessages = 0;
+	std::atomic<uint64_t> coalescedRequests = 0;
 	std::atomic<uint8_t> encoding = 0;
+	std::atomic<uint32_t> eventSubscriptions = EventSubscription::Default;
+	std::atomic<bool> compressionEnabled = false;
+	std::shared_ptr<SerialExecutor> executor;
+	std::unique_ptr<SessionTransport> transport;
+	SessionOutboundQueue outbound;
+	TokenBucket inboundBucket;
 };
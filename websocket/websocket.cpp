@@ -1,5 +1,6 @@
 #include <chrono>
 #include <thread>
+#include <algorithm>
 #include <functional>
 
 #include <QDateTime>
@@ -9,9 +10,24 @@
 #include <QHostAddress>
 #include <QRunnable>
 
+#include <openssl/ssl.h>
+#include <openssl/rand.h>
+#include <websocketpp/processors/hybi13.hpp>
+
 #include "websocket.h"
 
 #define SERVER_PORT 8359
+#define TLS_SERVER_PORT 8360
+// lifetime of TLS sessions and tickets, clients resume within it without a full handshake
+#define TLS_SESSION_TIMEOUT_SEC 86400
+#define MAX_IO_THREADS 16
+// how long Stop() waits for clients to finish the close handshake
+#define STOP_TIMEOUT_MS 500
+// websocketpp drops a connection whose close handshake takes longer, below STOP_TIMEOUT_MS so
+// the connections of a stopping server end on their own strand
+#define CLOSE_HANDSHAKE_TIMEOUT_MS 400
+// how long Stop() waits for the connections it terminated to report their close
+#define TERMINATE_TIMEOUT_MS 100
 
 namespace compat {
 // Reimplement QRunnable for std::function. Retrocompatability for Qt < 5.15
@@ -28,7 +44,13 @@ QRunnable* CreateFunctionRunnable(std::function<void()> func) {
 }
 } // namespace compat
 
-static std::string GetLocalAddress() {
+static std::string GetLocalAddress(const WebSocketListener& listener) {
+	// nothing to guess when the listener is bound to one address
+	websocketpp::lib::asio::error_code errorCode;
+	auto bound = websocketpp::lib::asio::ip::make_address(listener.address, errorCode);
+	if (!errorCode && !bound.is_unspecified())
+		return listener.address;
+
 	std::vector<QString> validAddresses;
 	for (auto address : QNetworkInterface::allAddresses()) {
 		// Exclude addresses which won't work
@@ -86,20 +108,75 @@ static std::string GetLocalAddress() {
 	return preferredAddresses[0].first.toStdString();
 }
 
-WebSocketServer::WebSocketServer() : QObject(nullptr) {
-	server.get_alog().clear_channels(websocketpp::log::alevel::all);
-	server.get_elog().clear_channels(websocketpp::log::elevel::all);
+static size_t DefaultIOThreadCount() {
+	size_t count = std::thread::hardware_concurrency() / 2;
+	return std::clamp<size_t>(count, 1, 4);
+}
+
+static int64_t SteadyMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		 std::chrono::steady_clock::now().time_since_epoch())
+	  .count();
+}
+
+static RequestResult ThrottledResult() {
+	return RequestResult::Error(RequestStatus::TooManyRequests,
+				    "Your session is sending messages faster than the rate limit.");
+}
+
+WebSocketServer::WebSocketServer()
+  : QObject(nullptr),
+    statsStream(this),
+    thumbnailStream(this),
+    packetStream(this),
+    eventPublisher(this),
+    stateSync(this),
+    requestHandler(&statsStream, &thumbnailStream, &packetStream, &eventPublisher, &stateSync),
+    ioThreadCount(DefaultIOThreadCount()),
+    listeners({{"0.0.0.0", SERVER_PORT, false}}),
+    tlsListener({"0.0.0.0", TLS_SERVER_PORT, false}) {
 	server.init_asio();
+	// every endpoint shares one io_context and its threads
+	tlsServer.init_asio(&server.get_io_service());
+
+	InitEndpoint(server, false);
+	InitEndpoint(tlsServer, true);
 
-	server.set_validate_handler(websocketpp::lib::bind(&WebSocketServer::onValidate, this,
-							   websocketpp::lib::placeholders::_1));
-	server.set_open_handler(websocketpp::lib::bind(&WebSocketServer::onOpen, this,
-						       websocketpp::lib::placeholders::_1));
-	server.set_close_handler(websocketpp::lib::bind(&WebSocketServer::onClose, this,
-							websocketpp::lib::placeholders::_1));
-	server.set_message_handler(websocketpp::lib::bind(&WebSocketServer::onMessage, this,
-							  websocketpp::lib::placeholders::_1,
-							  websocketpp::lib::placeholders::_2));
+	tlsServer.set_tls_init_handler([this](websocketpp::connection_hdl) {
+		std::lock_guard<std::mutex> lock(tlsMutex);
+		return tlsContext;
+	});
+
+	RAND_bytes(tlsTicketKeys, sizeof(tlsTicketKeys));
+}
+
+template<typename Endpoint> void WebSocketServer::InitEndpoint(Endpoint& endpoint, bool secure) {
+	using websocketpp::connection_hdl;
+
+	endpoint.get_alog().clear_channels(websocketpp::log::alevel::all);
+	endpoint.get_elog().clear_channels(websocketpp::log::elevel::all);
+	endpoint.set_close_handshake_timeout(CLOSE_HANDSHAKE_TIMEOUT_MS);
+
+	endpoint.set_validate_handler(
+	  [this, &endpoint](connection_hdl hdl) { return onValidate(endpoint, hdl); });
+	endpoint.set_open_handler(
+	  [this, &endpoint, secure](connection_hdl hdl) { onOpen(endpoint, hdl, secure); });
+	endpoint.set_close_handler([this, &endpoint](connection_hdl hdl) { onClose(endpoint, hdl); });
+	endpoint.set_message_handler(
+	  [this, &endpoint](connection_hdl hdl, typename Endpoint::message_ptr message) {
+		  onMessage(endpoint, hdl, message);
+	  });
+	endpoint.set_pong_handler(
+	  [this, &endpoint](connection_hdl hdl, std::string) { onPong(endpoint, hdl); });
+	// only `SessionTransport::Terminate()` interrupts, runs on the connection's strand
+	endpoint.set_interrupt_handler([&endpoint](connection_hdl hdl) {
+		websocketpp::lib::error_code errorCode;
+		auto conn = endpoint.get_con_from_hdl(hdl, errorCode);
+		if (errorCode)
+			return;
+		// the pending reads and writes fail, websocketpp then runs `onClose` as usual
+		conn->get_raw_socket().close(errorCode);
+	});
 }
 
 WebSocketServer::~WebSocketServer() {
@@ -107,6 +184,154 @@ WebSocketServer::~WebSocketServer() {
 		Stop();
 }
 
+void WebSocketServer::SetIOThreadCount(size_t count) {
+	if (server.is_listening()) {
+		blog(LOG_WARNING,
+		     "[WebSocketServer::SetIOThreadCount] Can not change IO threads while listening.");
+		return;
+	}
+
+	ioThreadCount = std::clamp<size_t>(count, 1, MAX_IO_THREADS);
+}
+
+template<typename Endpoint>
+bool WebSocketServer::Listen(Endpoint& endpoint, const WebSocketListener& listener) {
+	namespace ip = websocketpp::lib::asio::ip;
+
+	websocketpp::lib::error_code errorCode;
+	ip::address address = ip::make_address(listener.address, errorCode);
+	if (errorCode) {
+		blog(LOG_WARNING, "[WebSocketServer::Listen] Invalid address `%s`: %s",
+		     listener.address.c_str(), errorCode.message().c_str());
+		return false;
+	}
+
+	// socket options that only apply before bind
+	bool dualStack = address.is_v6() && address.is_unspecified();
+	bool reusePort = listener.reusePort;
+	endpoint.set_tcp_pre_bind_handler([dualStack, reusePort](auto acceptor) {
+		websocketpp::lib::asio::error_code optionError;
+		// `::` also takes IPv4 connections, Windows defaults to IPv6 only
+		if (dualStack)
+			acceptor->set_option(ip::v6_only(false), optionError);
+		if (!optionError && reusePort) {
+#ifdef SO_REUSEPORT
+			typedef websocketpp::lib::asio::detail::socket_option::boolean<SOL_SOCKET,
+										       SO_REUSEPORT>
+			  reuse_port;
+			acceptor->set_option(reuse_port(true), optionError);
+#else
+			blog(LOG_WARNING,
+			     "[WebSocketServer::Listen] SO_REUSEPORT is not supported, ignored.");
+#endif
+		}
+		return optionError;
+	});
+
+	endpoint.listen(ip::tcp::endpoint(address, listener.port), errorCode);
+	if (errorCode) {
+		blog(LOG_WARNING, "[WebSocketServer::Listen] Listen on %s port %d failed: %s",
+		     listener.address.c_str(), listener.port, errorCode.message().c_str());
+		return false;
+	}
+
+	endpoint.start_accept(errorCode);
+	if (errorCode) {
+		blog(LOG_WARNING, "[WebSocketServer::Listen] Accept on %s port %d failed: %s",
+		     listener.address.c_str(), listener.port, errorCode.message().c_str());
+		endpoint.stop_listening(errorCode);
+		return false;
+	}
+
+	blog(LOG_INFO, "[WebSocketServer::Listen] Listening on %s port %d%s",
+	     listener.address.c_str(), listener.port, listener.reusePort ? ", SO_REUSEPORT" : "");
+	return true;
+}
+
+void WebSocketServer::SetListeners(std::vector<WebSocketListener> listeners) {
+	if (server.is_listening()) {
+		blog(LOG_WARNING,
+		     "[WebSocketServer::SetListeners] Can not change listeners while listening.");
+		return;
+	}
+	if (listeners.empty()) {
+		blog(LOG_WARNING, "[WebSocketServer::SetListeners] At least one listener is needed.");
+		return;
+	}
+
+	this->listeners = std::move(listeners);
+}
+
+void WebSocketServer::SetTlsOptions(const WebSocketListener& listener,
+				    const std::string& certificateFile,
+				    const std::string& privateKeyFile) {
+	if (server.is_listening()) {
+		blog(LOG_WARNING,
+		     "[WebSocketServer::SetTlsOptions] Can not change TLS options while listening.");
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(tlsMutex);
+	tlsListener = listener;
+	tlsCertificateFile = certificateFile;
+	tlsPrivateKeyFile = privateKeyFile;
+}
+
+WebSocketServer::TlsContextPtr WebSocketServer::CreateTlsContext() {
+	namespace ssl = websocketpp::lib::asio::ssl;
+
+	std::string certificateFile;
+	std::string privateKeyFile;
+	{
+		std::lock_guard<std::mutex> lock(tlsMutex);
+		certificateFile = tlsCertificateFile;
+		privateKeyFile = tlsPrivateKeyFile;
+	}
+
+	auto context = std::make_shared<ssl::context>(ssl::context::tls_server);
+	websocketpp::lib::asio::error_code errorCode;
+	context->set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 |
+			       ssl::context::no_sslv3 | ssl::context::no_tlsv1 |
+			       ssl::context::no_tlsv1_1 | ssl::context::single_dh_use,
+			     errorCode);
+	if (!errorCode)
+		context->use_certificate_chain_file(certificateFile, errorCode);
+	if (!errorCode)
+		context->use_private_key_file(privateKeyFile, ssl::context::pem, errorCode);
+	if (errorCode) {
+		blog(LOG_ERROR, "[WebSocketServer::CreateTlsContext] Can not load `%s`: %s",
+		     certificateFile.c_str(), errorCode.message().c_str());
+		return nullptr;
+	}
+
+	// Resumption: a server-side session cache for TLS 1.2 clients that send a session ID,
+	// and tickets for everyone else. The ticket keys are shared by every context, so a
+	// reload does not force the next reconnect of every client into a full handshake.
+	SSL_CTX* native = context->native_handle();
+	static const unsigned char sessionIdContext[] = "recorder-websocket";
+	SSL_CTX_set_session_id_context(native, sessionIdContext, sizeof(sessionIdContext) - 1);
+	SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_set_timeout(native, TLS_SESSION_TIMEOUT_SEC);
+	SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+	SSL_CTX_set_tlsext_ticket_keys(native, tlsTicketKeys, sizeof(tlsTicketKeys));
+
+	return context;
+}
+
+bool WebSocketServer::ReloadTlsCertificate() {
+	TlsContextPtr context = CreateTlsContext();
+	if (!context)
+		return false;
+
+	// connections keep a reference to the context they were accepted with
+	std::lock_guard<std::mutex> lock(tlsMutex);
+	tlsContext = std::move(context);
+
+	blog(LOG_INFO, "[WebSocketServer::ReloadTlsCertificate] Loaded `%s`.",
+	     tlsCertificateFile.c_str());
+	return true;
+}
+
 void WebSocketServer::ServerRunner() {
 	blog(LOG_INFO, "[WebSocketServer::ServerRunner] IO thread started.");
 	try {
@@ -134,31 +359,55 @@ void WebSocketServer::Start() {
 		return;
 	}
 
-	// Set log levels if debug is enabled
-	server.get_alog().clear_channels(websocketpp::log::alevel::all);
-	server.get_elog().clear_channels(websocketpp::log::elevel::all);
-
 	server.reset();
 
-	websocketpp::lib::error_code errorCode;
-	blog(LOG_INFO, "[WebSocketServer::Start] Locked to IPv4 bindings");
-	server.listen(websocketpp::lib::asio::ip::tcp::v4(), SERVER_PORT, errorCode);
-
-	if (errorCode) {
-		std::string errorCodeMessage = errorCode.message();
-		blog(LOG_INFO, "[WebSocketServer::Start] Listen failed: %s",
-		     errorCodeMessage.c_str());
+	if (!Listen(server, listeners[0])) {
+		blog(LOG_INFO, "[WebSocketServer::Start] Listen failed");
 		return;
 	}
 
-	server.start_accept();
+	// The other listeners get endpoints of their own on the same io_context, a failure only
+	// loses that listener
+	for (size_t i = 1; i < listeners.size(); i++) {
+		if (extraEndpoints.size() < i) {
+			auto endpoint = std::make_unique<websocketpp::server<WebSocketConfig>>();
+			endpoint->init_asio(&server.get_io_service());
+			InitEndpoint(*endpoint, false);
+			extraEndpoints.push_back(std::move(endpoint));
+		}
+		Listen(*extraEndpoints[i - 1], listeners[i]);
+	}
+
+	// An optional TLS endpoint, a failure leaves the plain ones running
+	bool tlsEnabled;
+	WebSocketListener tlsBinding;
+	{
+		std::lock_guard<std::mutex> lock(tlsMutex);
+		tlsEnabled = !tlsCertificateFile.empty();
+		tlsBinding = tlsListener;
+	}
+	if (tlsEnabled && ReloadTlsCertificate())
+		Listen(tlsServer, tlsBinding);
+
+	// the tick chain runs until `Stop()` moves on to the next generation
+	heartbeats.Reset();
+	heartbeatEpochMs = SteadyMs();
+	heartbeatTickMs = std::max<long>(WebSocketHeartbeat::tickMs, 10);
+	uint64_t generation = runGeneration;
+	server.set_timer(heartbeatTickMs,
+			 [this, generation](const websocketpp::lib::error_code& ec) {
+				 if (!ec && generation == runGeneration)
+					 HeartbeatTick();
+			 });
 
 	blog(
 	  LOG_INFO,
-	  "[WebSocketServer::Start] Server started successfully on port %d. Possible connect address: %s",
-	  SERVER_PORT, GetLocalAddress().c_str());
+	  "[WebSocketServer::Start] Server started successfully on port %d with %zu IO threads. Possible connect address: %s",
+	  listeners[0].port, ioThreadCount, GetLocalAddress(listeners[0]).c_str());
 
-	serverThread = std::thread(&WebSocketServer::ServerRunner, this);
+	serverThreads.reserve(ioThreadCount);
+	for (size_t i = 0; i < ioThreadCount; i++)
+		serverThreads.emplace_back(&WebSocketServer::ServerRunner, this);
 }
 
 void WebSocketServer::Stop() {
@@ -168,51 +417,150 @@ void WebSocketServer::Stop() {
 		return;
 	}
 
-	server.stop_listening();
+	auto startedAt = std::chrono::steady_clock::now();
+	auto deadline = startedAt + std::chrono::milliseconds(STOP_TIMEOUT_MS);
 
-	std::unique_lock<std::mutex> lock(sessionMutex);
-	for (auto const& [hdl, session] : sessions) {
-		websocketpp::lib::error_code errorCode;
-		server.pause_reading(hdl, errorCode);
+	websocketpp::lib::error_code errorCode;
+	server.stop_listening(errorCode);
+	if (errorCode)
+		blog(LOG_INFO, "[WebSocketServer::Stop] Error: %s", errorCode.message().c_str());
+	for (auto& endpoint : extraEndpoints) {
+		if (!endpoint->is_listening())
+			continue;
+		endpoint->stop_listening(errorCode);
+		if (errorCode)
+			blog(LOG_INFO, "[WebSocketServer::Stop] Error: %s",
+			     errorCode.message().c_str());
+	}
+	if (tlsServer.is_listening()) {
+		tlsServer.stop_listening(errorCode);
+		if (errorCode)
+			blog(LOG_INFO, "[WebSocketServer::Stop] Error: %s",
+			     errorCode.message().c_str());
+	}
+
+	auto snapshot = sessions.Load();
+	size_t sessionCount = snapshot->size();
+	for (auto const& entry : *snapshot) {
+		SessionTransport* transport = entry.session->Transport();
+		transport->PauseReading(errorCode);
 		if (errorCode) {
 			blog(LOG_INFO, "[WebSocketServer::Stop] Error: %s",
 			     errorCode.message().c_str());
 			continue;
 		}
 
-		server.close(hdl, websocketpp::close::status::going_away, "Server stopping.",
-			     errorCode);
+		transport->Close(websocketpp::close::status::going_away, "Server stopping.",
+				 errorCode);
 		if (errorCode) {
 			blog(LOG_INFO, "[WebSocketServer::Stop] Error: %s",
 			     errorCode.message().c_str());
 			continue;
 		}
 	}
+	snapshot.reset();
+
+	// `onClose` signals every session it removes
+	std::unique_lock<std::mutex> lock(stopMutex);
+	sessionsClosed.wait_until(lock, deadline, [this]() { return sessions.Size() == 0; });
 	lock.unlock();
 
-	threadPool.waitForDone();
+	// Sessions whose close handshake did not finish in time lose their sockets now, nothing
+	// of them stays queued on the io_context for the next `Start()`. The termination runs
+	// on each connection's strand, wait for their `onClose` before stopping the io_context.
+	auto leftover = sessions.Load();
+	if (!leftover->empty()) {
+		for (auto const& entry : *leftover)
+			entry.session->Transport()->Terminate();
+
+		lock.lock();
+		sessionsClosed.wait_for(lock, std::chrono::milliseconds(TERMINATE_TIMEOUT_MS),
+					[this]() { return sessions.Size() == 0; });
+		lock.unlock();
+	}
+
+	// Stop the io_context instead of waiting for it to run out of work, the heartbeat chain and
+	// pending retry timers of this run turn into no-ops
+	runGeneration++;
+	server.stop();
+	for (auto& thread : serverThreads) {
+		if (thread.joinable())
+			thread.join();
+	}
+	serverThreads.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(tlsMutex);
+		tlsContext.reset();
+	}
+
+	thumbnailStream.Stop();
+	packetStream.Stop();
+
+	// connections that did not even report their termination are reported here, their
+	// `onClose` of a later run finds them gone
+	size_t terminated = 0;
+	for (auto const& [id, hdl, session] : *leftover) {
+		if (!sessions.Remove(id))
+			continue;
+		session->Outbound().Clear();
+		terminated++;
+
+		WebSocketSessionState state;
+		state.sessionId = id;
+		state.hdl = hdl;
+		state.remoteAddress = session->RemoteAddress();
+		state.connectedAt = session->ConnectedAt();
+		state.incomingMessages = session->IncomingMessages();
+		state.outgoingMessages = session->OutgoingMessages();
+		state.encoding = WebSocketEncoding(session->Encoding());
 
-	// This can delay the thread that it is running on. Bad but kinda required.
-	while (sessions.size() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		emit ClientDisconnected(state, websocketpp::close::status::abnormal_close);
+	}
+	leftover.reset();
+
+	// no session is left, disconnect every event source now rather than on the queued update
+	UpdateSubscribedTopics();
+	eventPublisher.Stop();
+	stateSync.Stop();
 
-	serverThread.join();
+	// Nothing feeds the session executors anymore, drop what has not started yet and wait
+	// for the few tasks already running
+	threadPool.clear();
+	threadPool.waitForDone();
 
-	blog(LOG_INFO, "[WebSocketServer::Stop] Server stopped successfully");
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+	  std::chrono::steady_clock::now() - startedAt);
+	blog(LOG_INFO,
+	     "[WebSocketServer::Stop] Server stopped in %lld ms, %zu sessions closed, %zu terminated",
+	     (long long)elapsed.count(), sessionCount - terminated, terminated);
 }
 
 void WebSocketServer::InvalidateSession(websocketpp::connection_hdl hdl) {
 	blog(LOG_INFO, "[WebSocketServer::InvalidateSession] Invalidating a session.");
 
+	// the handle alone does not tell which endpoint owns the connection
+	SessionPtr session;
+	auto snapshot = sessions.Load();
+	for (auto& entry : *snapshot) {
+		if (!entry.hdl.owner_before(hdl) && !hdl.owner_before(entry.hdl)) {
+			session = entry.session;
+			break;
+		}
+	}
+	if (!session)
+		return;
+
 	websocketpp::lib::error_code errorCode;
-	server.pause_reading(hdl, errorCode);
+	session->Transport()->PauseReading(errorCode);
 	if (errorCode) {
 		blog(LOG_INFO, "[WebSocketServer::InvalidateSession] Error: %s",
 		     errorCode.message().c_str());
 		return;
 	}
 
-	server.close(hdl, WebSocketCloseCode::SessionInvalidated,
-		     "Your session has been invalidated.", errorCode);
+	session->Transport()->Close(WebSocketCloseCode::SessionInvalidated,
+				    "Your session has been invalidated.", errorCode);
 	if (errorCode) {
 		blog(LOG_INFO, "[WebSocketServer::InvalidateSession] Error: %s",
 		     errorCode.message().c_str());
@@ -223,100 +571,595 @@ void WebSocketServer::InvalidateSession(websocketpp::connection_hdl hdl) {
 std::vector<WebSocketSessionState> WebSocketServer::GetWebSocketSessions() {
 	std::vector<WebSocketSessionState> webSocketSessions;
 
-	std::unique_lock<std::mutex> lock(sessionMutex);
-	for (auto& [hdl, session] : sessions) {
+	auto snapshot = sessions.Load();
+	webSocketSessions.reserve(snapshot->size());
+	for (auto& [id, hdl, session] : *snapshot) {
 		uint64_t connectedAt = session->ConnectedAt();
 		uint64_t incomingMessages = session->IncomingMessages();
 		uint64_t outgoingMessages = session->OutgoingMessages();
 		std::string remoteAddress = session->RemoteAddress();
+		auto encoding = WebSocketEncoding(session->Encoding());
 
 		webSocketSessions.emplace_back(WebSocketSessionState{
-		  hdl, remoteAddress, connectedAt, incomingMessages, outgoingMessages});
+		  id, hdl, remoteAddress, connectedAt, incomingMessages, outgoingMessages, encoding});
 	}
-	lock.unlock();
 
 	return webSocketSessions;
 }
 
 void WebSocketServer::SendMessageToClient(const WebSocketSessionState& state, const char* msg) {
-	std::unique_lock<std::mutex> lock(sessionMutex);
-	SessionPtr session;
-	try {
-		session = sessions.at(state.hdl);
-	} catch (const std::out_of_range& oor) {
-		UNUSED_PARAMETER(oor);
+	SessionEntry entry;
+	if (!sessions.Find(state.sessionId, entry))
 		return;
-	}
-	lock.unlock();
 
-	session->IncrementOutgoingMessages();
+	SendFrame(entry.hdl, entry.session, MakeMessage(msg, false));
+}
 
-	websocketpp::lib::error_code errorCode;
-	server.send(state.hdl, msg, websocketpp::frame::opcode::text, errorCode);
+void WebSocketServer::SendMessageToClient(const WebSocketSessionState& state,
+					  const json11::Json& msg) {
+	SessionEntry entry;
+	if (!sessions.Find(state.sessionId, entry))
+		return;
+
+	SendJson(entry.hdl, entry.session, msg);
+}
+
+void WebSocketServer::SendJson(websocketpp::connection_hdl hdl, const SessionPtr& session,
+			       const json11::Json& msg) {
+	auto encoding = WebSocketEncoding(session->Encoding());
+	SendFrame(hdl, session, MakeMessage(codec::Encode(encoding, msg), codec::IsBinary(encoding)));
+}
+
+WebSocketServer::SharedFrame WebSocketServer::MakeMessage(const std::string& payload,
+							  bool binary) {
+	auto manager = websocketpp::lib::make_shared<WebSocketConfig::con_msg_manager_type>();
+	auto message = manager->get_message(binary ? websocketpp::frame::opcode::binary
+						   : websocketpp::frame::opcode::text,
+					    payload.size());
+	message->set_payload(payload);
+
+	// only sessions that negotiated permessage-deflate look at this flag
+	message->set_compressed(payload.size() >= WebSocketCompression::threshold);
+
+	return message;
+}
+
+WebSocketServer::SharedFrame WebSocketServer::MakeSharedFrame(const std::string& payload,
+							      bool binary) {
+	typedef websocketpp::config::asio config;
+
+	auto manager = websocketpp::lib::make_shared<config::con_msg_manager_type>();
+	auto message = manager->get_message(binary ? websocketpp::frame::opcode::binary
+						   : websocketpp::frame::opcode::text,
+					    payload.size());
+	message->set_payload(payload);
+
+	// Server frames are never masked, so the header and payload written by the processor are
+	// identical for every connection. websocketpp skips its per-connection copy for messages
+	// that are already prepared. The plain asio config has no deflate extension, so the
+	// frame is never compressed here.
+	config::rng_type rng;
+	websocketpp::processor::hybi13<config> processor(false, true, manager, rng);
+	SharedFrame frame = manager->get_message();
+	websocketpp::lib::error_code errorCode = processor.prepare_data_frame(message, frame);
 	if (errorCode) {
-		blog(LOG_INFO, "[WebSocketServer::SendMessageToClient] Error: %s",
+		blog(LOG_INFO, "[WebSocketServer::MakeSharedFrame] Error: %s",
 		     errorCode.message().c_str());
+		return nullptr;
+	}
+
+	return frame;
+}
+
+SessionRegistry::Snapshot WebSocketServer::CollectReceivers(uint32_t topics,
+							    const SessionFilter& filter) {
+	SessionRegistry::Snapshot receivers;
+
+	auto snapshot = sessions.Load();
+	receivers.reserve(snapshot->size());
+	for (auto& entry : *snapshot) {
+		if (topics && (entry.session->EventSubscriptions() & topics) == 0)
+			continue;
+		// nothing is locked here, the filter may call back into the server
+		if (filter && !filter(entry.session))
+			continue;
+		receivers.push_back(entry);
+	}
+
+	return receivers;
+}
+
+void WebSocketServer::SendFrame(websocketpp::connection_hdl hdl, const SessionPtr& session,
+				const SharedFrame& frame, uint32_t topic) {
+	SessionOutboundQueue::Limits limits{WebSocketBackpressure::maxQueuedBytes,
+					    WebSocketBackpressure::maxQueuedMessages,
+					    WebSocketBackpressure::policy,
+					    EventSubscription::Snapshots};
+
+	size_t bytes = frame->get_header().size() + frame->get_payload().size();
+	auto result = session->Outbound().Push(frame, bytes, topic, limits);
+
+	if (result == SessionOutboundQueue::kOverflow) {
+		blog(LOG_WARNING,
+		     "[WebSocketServer::SendFrame] Client `%s` is not reading, %zu messages (%zu bytes) queued. Disconnecting.",
+		     session->RemoteAddress().c_str(), session->QueueDepth(),
+		     session->QueuedBytes());
+
+		session->Outbound().Clear();
+
+		websocketpp::lib::error_code errorCode;
+		session->Transport()->Close(WebSocketCloseCode::SlowConsumer,
+					    "Your session is not reading its messages fast enough.",
+					    errorCode);
+		return;
+	}
+
+	PumpOutbound(hdl, session);
+}
+
+void WebSocketServer::PumpOutbound(websocketpp::connection_hdl hdl, const SessionPtr& session) {
+	SessionTransport* transport = session->Transport();
+	if (!transport->Connected()) {
+		session->Outbound().Clear();
+		return;
+	}
+
+	size_t inFlightBytes = WebSocketBackpressure::inFlightBytes;
+	bool pending = session->Outbound().Drain(
+	  [&]() { return transport->BufferedAmount() < inFlightBytes; },
+	  [&](const SharedFrame& frame) {
+		  session->IncrementOutgoingMessages();
+
+		  auto sendError = transport->Send(frame);
+		  if (sendError)
+			  blog(LOG_INFO, "[WebSocketServer::PumpOutbound] Error: %s",
+			       sendError.message().c_str());
+	  });
+
+	// websocketpp has no per-message write callback, poll until the socket catches up
+	if (pending && session->Outbound().ArmRetry()) {
+		uint64_t generation = runGeneration;
+		server.set_timer(WebSocketBackpressure::retryMs,
+				 [this, hdl, session, generation](const websocketpp::lib::error_code& ec) {
+					 session->Outbound().DisarmRetry();
+					 if (!ec && generation == runGeneration)
+						 PumpOutbound(hdl, session);
+				 });
+	}
+}
+
+void WebSocketServer::ScheduleHeartbeat(SessionId id, int64_t atMs) {
+	int64_t tick = (atMs - heartbeatEpochMs + heartbeatTickMs - 1) / heartbeatTickMs;
+	heartbeats.Schedule(id, uint64_t(std::max<int64_t>(tick, 0)));
+}
+
+void WebSocketServer::HeartbeatTick() {
+	int64_t now = SteadyMs();
+	uint64_t tick = uint64_t((now - heartbeatEpochMs) / heartbeatTickMs);
+
+	for (SessionId id : heartbeats.Advance(tick)) {
+		// closed sessions simply drop out of the wheel
+		SessionEntry entry;
+		if (sessions.Find(id, entry))
+			CheckHeartbeat(entry, now);
+	}
+
+	uint64_t generation = runGeneration;
+	server.set_timer(heartbeatTickMs,
+			 [this, generation](const websocketpp::lib::error_code& ec) {
+				 if (!ec && generation == runGeneration)
+					 HeartbeatTick();
+			 });
+}
+
+void WebSocketServer::CheckHeartbeat(const SessionEntry& entry, int64_t nowMs) {
+	long pingIntervalMs = WebSocketHeartbeat::pingIntervalMs;
+	long idleTimeoutMs = WebSocketHeartbeat::idleTimeoutMs;
+
+	int64_t lastActivity = entry.session->LastActivity();
+	int64_t idleMs = nowMs - lastActivity;
+
+	// activity since the last check, nothing to do before the next ping is due
+	if (idleMs < pingIntervalMs) {
+		ScheduleHeartbeat(entry.id, lastActivity + pingIntervalMs);
 		return;
 	}
+
+	websocketpp::lib::error_code errorCode;
+	if (idleMs >= idleTimeoutMs) {
+		blog(LOG_WARNING,
+		     "[WebSocketServer::CheckHeartbeat] Client `%s` was silent for %lld ms. Disconnecting.",
+		     entry.session->RemoteAddress().c_str(), (long long)idleMs);
+
+		// a half-open connection never answers, websocketpp terminates it once the close
+		// handshake times out and `onClose` removes the session
+		entry.session->Transport()->Close(WebSocketCloseCode::SessionTimeout,
+						  "Your session did not answer the heartbeat in time.",
+						  errorCode);
+		ScheduleHeartbeat(entry.id, nowMs + pingIntervalMs);
+		return;
+	}
+
+	entry.session->Transport()->Ping(errorCode);
+
+	ScheduleHeartbeat(entry.id, std::min<int64_t>(nowMs + pingIntervalMs,
+						      lastActivity + idleTimeoutMs));
 }
 
-bool WebSocketServer::onValidate(websocketpp::connection_hdl hdl) {
+void WebSocketServer::SendSharedFrame(websocketpp::connection_hdl hdl, const SessionPtr& session,
+				      const SharedFrame& frame, SharedFrame& deflatable,
+				      uint32_t topic) {
+	// A prepared frame bypasses the deflate extension. Sessions that negotiated compression
+	// get one unprepared copy instead, which their connections compress independently.
+	if (session->CompressionEnabled() &&
+	    frame->get_payload().size() >= WebSocketCompression::threshold) {
+		if (!deflatable)
+			deflatable =
+			  MakeMessage(frame->get_payload(),
+				      frame->get_opcode() == websocketpp::frame::opcode::binary);
+		SendFrame(hdl, session, deflatable, topic);
+		return;
+	}
+
+	SendFrame(hdl, session, frame, topic);
+}
+
+size_t WebSocketServer::Broadcast(const SharedFrame& frame, uint32_t topics,
+				  const SessionFilter& filter) {
+	if (!frame || (topics && !HasSubscribers(topics)))
+		return 0;
+
+	bool binary = frame->get_opcode() == websocketpp::frame::opcode::binary;
+
+	size_t count = 0;
+	SharedFrame deflatable;
+	for (auto& [id, hdl, session] : CollectReceivers(topics, filter)) {
+		if (codec::IsBinary(WebSocketEncoding(session->Encoding())) != binary)
+			continue;
+
+		SendSharedFrame(hdl, session, frame, deflatable, topics);
+		count++;
+	}
+
+	return count;
+}
+
+size_t WebSocketServer::BroadcastMedia(const SharedFrame& frame, uint32_t topics,
+				       const SessionFilter& filter) {
+	if (!frame || (topics && !HasSubscribers(topics)))
+		return 0;
+
+	auto receivers = CollectReceivers(topics, filter);
+	for (auto& [id, hdl, session] : receivers)
+		SendFrame(hdl, session, frame, topics);
+
+	return receivers.size();
+}
+
+size_t WebSocketServer::Broadcast(const json11::Json& event, uint32_t topics,
+				  const SessionFilter& filter) {
+	if (topics && !HasSubscribers(topics))
+		return 0;
+
+	auto receivers = CollectReceivers(topics, filter);
+	if (receivers.empty())
+		return 0;
+
+	// one frame per encoding, built lazily so unused encodings cost nothing
+	SharedFrame frames[2];
+	SharedFrame deflatables[2];
+	for (auto& [id, hdl, session] : receivers) {
+		auto encoding = WebSocketEncoding(session->Encoding());
+		size_t idx = encoding == WebSocketEncoding::MsgPack ? 1 : 0;
+		if (!frames[idx]) {
+			frames[idx] = MakeSharedFrame(codec::Encode(encoding, event),
+						      codec::IsBinary(encoding));
+			if (!frames[idx])
+				return 0;
+		}
+
+		SendSharedFrame(hdl, session, frames[idx], deflatables[idx], topics);
+	}
+
+	return receivers.size();
+}
+
+void WebSocketServer::UpdateSubscribedTopics() {
+	// serialized so an older union can never overwrite a newer one
+	std::lock_guard<std::mutex> lock(subscribedTopicsMutex);
+
+	uint32_t topics = 0;
+	auto snapshot = sessions.Load();
+	for (auto& entry : *snapshot)
+		topics |= entry.session->EventSubscriptions();
+
+	if (subscribedTopics.exchange(topics) == topics)
+		return;
+
+	// signals are connected on the thread the server lives on, the publisher reads the
+	// latest union so queued updates that arrive out of order still settle correctly
+	QMetaObject::invokeMethod(
+	  this, [this]() { eventPublisher.Update(subscribedTopics); }, Qt::QueuedConnection);
+}
+
+void WebSocketServer::DispatchRequest(websocketpp::connection_hdl hdl, const SessionPtr& session,
+				      const Request& request, bool throttled) {
+	if (throttled) {
+		SendJson(hdl, session,
+			 json11::Json::object{
+			   {"op", WebSocketOpCode::RequestResponse},
+			   {"d", RequestHandler::BuildResponse(request, ThrottledResult())},
+			 });
+		return;
+	}
+
+	QueueRequest(hdl, session, request);
+}
+
+void WebSocketServer::QueueRequest(websocketpp::connection_hdl hdl, const SessionPtr& session,
+				   const Request& request) {
+	std::string key = RequestHandler::CoalesceKey(request);
+	if (!key.empty()) {
+		key = std::to_string(session->Id()) + '/' + key;
+
+		// Replace the request still waiting for the UI thread instead of queueing another
+		// task, a drag at mouse rate then costs one task per UI thread turn
+		std::lock_guard<std::mutex> lock(pendingRequestsMutex);
+		auto it = pendingRequests.find(key);
+		if (it != pendingRequests.end()) {
+			it->second.replacedIds.push_back(std::move(it->second.request.requestId));
+			it->second.request = request;
+			session->IncrementCoalescedRequests();
+			return;
+		}
+		pendingRequests.emplace(key, PendingRequest{request, {}});
+	}
+
+	// Requests touch the same core APIs as the UI, run them on its thread. Queued calls keep
+	// their order, so one session's requests still finish in order.
+	QMetaObject::invokeMethod(
+	  this,
+	  [this, hdl, session, request, key]() {
+		  PendingRequest pending{request, {}};
+		  if (!key.empty()) {
+			  std::lock_guard<std::mutex> lock(pendingRequestsMutex);
+			  auto it = pendingRequests.find(key);
+			  pending = std::move(it->second);
+			  pendingRequests.erase(it);
+		  }
+
+		  RequestResult result = requestHandler.ProcessRequest(pending.request);
+
+		  Request answered = pending.request;
+		  for (auto& requestId : pending.replacedIds) {
+			  answered.requestId = std::move(requestId);
+			  SendJson(hdl, session,
+				   json11::Json::object{
+				     {"op", WebSocketOpCode::RequestResponse},
+				     {"d", RequestHandler::BuildResponse(answered, result)},
+				   });
+		  }
+
+		  SendJson(hdl, session,
+			   json11::Json::object{
+			     {"op", WebSocketOpCode::RequestResponse},
+			     {"d", RequestHandler::BuildResponse(pending.request, result)},
+			   });
+	  },
+	  Qt::QueuedConnection);
+}
+
+bool WebSocketServer::ProcessMessage(websocketpp::connection_hdl hdl, const SessionPtr& session,
+				     const json11::Json& message, bool throttled,
+				     ProcessResult& ret) {
+	if (!message.is_object() || !message["op"].is_number())
+		return false;
+
+	const json11::Json& d = message["d"];
+	if (!d.is_object()) {
+		ret.closeCode = WebSocketCloseCode::MissingDataField;
+		ret.closeReason = "Your request is missing a `d` object.";
+		return true;
+	}
+
+	switch (message["op"].int_value()) {
+	case WebSocketOpCode::Request: {
+		if (!d["requestType"].is_string()) {
+			ret.closeCode = WebSocketCloseCode::InvalidDataFieldType;
+			ret.closeReason = "Your request's `requestType` is not a string.";
+			return true;
+		}
+
+		DispatchRequest(hdl, session,
+				Request{d["requestType"].string_value(),
+					d["requestId"].string_value(), d["requestData"], session},
+				throttled);
+		return true;
+	}
+	case WebSocketOpCode::RequestBatch: {
+		if (!d["requests"].is_array()) {
+			ret.closeCode = WebSocketCloseCode::InvalidDataFieldType;
+			ret.closeReason = "Your batch's `requests` is not an array.";
+			return true;
+		}
+
+		std::vector<Request> requests;
+		requests.reserve(d["requests"].array_items().size());
+		for (auto& item : d["requests"].array_items()) {
+			requests.push_back(Request{item["requestType"].string_value(),
+						   item["requestId"].string_value(),
+						   item["requestData"], session});
+		}
+
+		std::string requestId = d["requestId"].string_value();
+		bool haltOnFailure = d["haltOnFailure"].bool_value();
+
+		// the whole batch counts as one message and is rejected as a whole
+		if (throttled) {
+			json11::Json::array responses;
+			responses.reserve(requests.size());
+			for (auto& request : requests)
+				responses.push_back(
+				  RequestHandler::BuildResponse(request, ThrottledResult()));
+
+			SendJson(hdl, session,
+				 json11::Json::object{
+				   {"op", WebSocketOpCode::RequestBatchResponse},
+				   {"d", json11::Json::object{{"requestId", requestId},
+							      {"results", responses}}},
+				 });
+			return true;
+		}
+
+		// The whole batch runs in one UI thread task and is answered with one frame
+		QMetaObject::invokeMethod(
+		  this,
+		  [this, hdl, session, requestId, haltOnFailure, requests]() {
+			  auto results = requestHandler.ProcessBatch(requests, haltOnFailure);
+
+			  json11::Json::array responses;
+			  responses.reserve(results.size());
+			  for (size_t i = 0; i < results.size(); i++)
+				  responses.push_back(
+				    RequestHandler::BuildResponse(requests[i], results[i]));
+
+			  SendJson(hdl, session,
+				   json11::Json::object{
+				     {"op", WebSocketOpCode::RequestBatchResponse},
+				     {"d", json11::Json::object{{"requestId", requestId},
+								{"results", responses}}},
+				   });
+		  },
+		  Qt::QueuedConnection);
+		return true;
+	}
+	default: break;
+	}
+
+	ret.closeCode = WebSocketCloseCode::UnknownOpCode;
+	ret.closeReason = "Your message has an unknown `op`.";
 	return true;
 }
 
-void WebSocketServer::onOpen(websocketpp::connection_hdl hdl) {
-	auto conn = server.get_con_from_hdl(hdl);
+template<typename Endpoint>
+bool WebSocketServer::onValidate(Endpoint& endpoint, websocketpp::connection_hdl hdl) {
+	auto conn = endpoint.get_con_from_hdl(hdl);
+
+	// Select the first subprotocol we understand, clients that ask for none get Json
+	for (auto& subprotocol : conn->get_requested_subprotocols()) {
+		WebSocketEncoding encoding;
+		if (codec::EncodingFromSubprotocol(subprotocol, encoding)) {
+			conn->select_subprotocol(subprotocol);
+			break;
+		}
+	}
+
+	return true;
+}
+
+template<typename Endpoint>
+void WebSocketServer::onOpen(Endpoint& endpoint, websocketpp::connection_hdl hdl, bool secure) {
+	auto conn = endpoint.get_con_from_hdl(hdl);
 
 	// Build new session
-	std::unique_lock<std::mutex> lock(sessionMutex);
-	SessionPtr session = sessions[hdl] = std::make_shared<WebSocketSession>();
+	SessionPtr session = std::make_shared<WebSocketSession>([this](SerialExecutor::Task task) {
+		threadPool.start(compat::CreateFunctionRunnable(std::move(task)));
+	});
 	std::unique_lock<std::mutex> sessionLock(session->OperationMutex);
-	lock.unlock();
+	// set before the session is published, everything that reaches it goes through it
+	session->SetTransport(std::make_unique<EndpointTransport<Endpoint>>(endpoint, hdl, secure));
+	session->SetId(sessions.Add(hdl, session));
+	conn->session = session;
+	UpdateSubscribedTopics();
 
 	// Configure session details
 	session->SetRemoteAddress(conn->get_remote_endpoint());
 	session->SetConnectedAt(QDateTime::currentSecsSinceEpoch());
+	session->Touch(SteadyMs());
+	ScheduleHeartbeat(session->Id(),
+			  session->LastActivity() + WebSocketHeartbeat::pingIntervalMs);
+
+	WebSocketEncoding encoding = WebSocketEncoding::Json;
+	codec::EncodingFromSubprotocol(conn->get_subprotocol(), encoding);
+	session->SetEncoding(uint8_t(encoding));
+
+	// websocketpp only answers with the extension when it accepted the client offer
+	session->SetCompressionEnabled(
+	  conn->get_response_header("Sec-WebSocket-Extensions").find("permessage-deflate") !=
+	  std::string::npos);
 
 	sessionLock.unlock();
 
 	// Build SessionState object for signal
 	WebSocketSessionState state;
+	state.sessionId = session->Id();
 	state.hdl = hdl;
 	state.remoteAddress = session->RemoteAddress();
 	state.connectedAt = session->ConnectedAt();
 	state.incomingMessages = session->IncomingMessages();
 	state.outgoingMessages = session->OutgoingMessages();
+	state.encoding = encoding;
 
 	// Emit signals
 	emit ClientConnected(state);
 
 	// Log connection
-	blog(LOG_INFO, "[WebSocketServer::onOpen] New WebSocket client has connected from %s",
-	     session->RemoteAddress().c_str());
+	blog(LOG_INFO,
+	     "[WebSocketServer::onOpen] New WebSocket client has connected from %s, encoding: %s%s",
+	     session->RemoteAddress().c_str(),
+	     encoding == WebSocketEncoding::MsgPack ? "MsgPack" : "Json", secure ? ", TLS" : "");
 
 	session->IncrementOutgoingMessages();
 }
 
-void WebSocketServer::onClose(websocketpp::connection_hdl hdl) {
-	auto conn = server.get_con_from_hdl(hdl);
+template<typename Endpoint>
+void WebSocketServer::onClose(Endpoint& endpoint, websocketpp::connection_hdl hdl) {
+	auto conn = endpoint.get_con_from_hdl(hdl);
 
 	// Get info from the session and then delete it
-	std::unique_lock<std::mutex> lock(sessionMutex);
-	SessionPtr session = sessions[hdl];
+	SessionPtr session = std::move(conn->session);
+	if (!session)
+		return;
+	// `Stop()` already reported the session
+	if (!sessions.Remove(session->Id()))
+		return;
+	UpdateSubscribedTopics();
+	{
+		// taken so the wakeup cannot slip between the check and the wait in `Stop()`
+		std::lock_guard<std::mutex> lock(stopMutex);
+	}
+	sessionsClosed.notify_all();
+
 	uint64_t connectedAt = session->ConnectedAt();
 	uint64_t incomingMessages = session->IncomingMessages();
 	uint64_t outgoingMessages = session->OutgoingMessages();
 	std::string remoteAddress = session->RemoteAddress();
-	sessions.erase(hdl);
-	lock.unlock();
+	auto encoding = WebSocketEncoding(session->Encoding());
+
+	// nothing queued can be delivered anymore
+	session->Outbound().Clear();
+
+	// streams run on the thread the server lives on, the media taps stop with their last
+	// subscriber
+	QMetaObject::invokeMethod(
+	  this,
+	  [this, session]() {
+		  statsStream.Unsubscribe(session);
+		  thumbnailStream.Unsubscribe(session);
+		  packetStream.Unsubscribe(session);
+		  stateSync.Unsubscribe(session);
+	  },
+	  Qt::QueuedConnection);
 
 	// Build SessionState object for signal
 	WebSocketSessionState state;
+	state.sessionId = session->Id();
 	state.hdl = hdl;
 	state.remoteAddress = remoteAddress;
 	state.connectedAt = connectedAt;
 	state.incomingMessages = incomingMessages;
 	state.outgoingMessages = outgoingMessages;
+	state.encoding = encoding;
 
 	// Emit signals
 	emit ClientDisconnected(state, conn->get_local_close_code());
@@ -329,47 +1172,118 @@ void WebSocketServer::onClose(websocketpp::connection_hdl hdl) {
 	  conn->get_local_close_reason().c_str());
 }
 
-void WebSocketServer::onMessage(
-  websocketpp::connection_hdl hdl,
-  websocketpp::server<websocketpp::config::asio>::message_ptr message) {
+template<typename Endpoint>
+void WebSocketServer::onPong(Endpoint& endpoint, websocketpp::connection_hdl hdl) {
+	websocketpp::lib::error_code errorCode;
+	auto conn = endpoint.get_con_from_hdl(hdl, errorCode);
+	if (!errorCode && conn->session)
+		conn->session->Touch(SteadyMs());
+}
+
+template<typename Endpoint>
+void WebSocketServer::onMessage(Endpoint& endpoint, websocketpp::connection_hdl hdl,
+				typename Endpoint::message_ptr message) {
+	// runs on the connection's strand, like `onOpen` and `onClose`
+	websocketpp::lib::error_code errorCode;
+	auto conn = endpoint.get_con_from_hdl(hdl, errorCode);
+	if (errorCode || !conn->session)
+		return;
+	SessionPtr session = conn->session;
+	session->Touch(SteadyMs());
+
 	auto opCode = message->get_opcode();
-	std::string payload = message->get_payload();
-
-	threadPool.start(compat::CreateFunctionRunnable([=]() {
-		std::unique_lock<std::mutex> lock(sessionMutex);
-		SessionPtr session;
-		try {
-			session = sessions.at(hdl);
-		} catch (const std::out_of_range& oor) {
-			UNUSED_PARAMETER(oor);
-			return;
-		}
-		lock.unlock();
+	std::string payload = std::move(message->get_raw_payload());
 
+	// Run on the session executor so messages of one client are handled in order while
+	// different clients are still processed in parallel on the thread pool
+	session->Executor()->Post([this, hdl, session, opCode, payload = std::move(payload)]() {
 		session->IncrementIncomingMessages();
 
-		// Check for invalid opcode and decode
+		// Check for invalid opcode, the frame type must match the negotiated encoding
 		websocketpp::lib::error_code errorCode;
+		SessionTransport* transport = session->Transport();
+		auto encoding = WebSocketEncoding(session->Encoding());
 
-		if (opCode != websocketpp::frame::opcode::text) {
-			server.close(
-			  hdl, WebSocketCloseCode::MessageDecodeError,
+		if (codec::IsBinary(encoding) && opCode != websocketpp::frame::opcode::binary) {
+			transport->Close(
+			  WebSocketCloseCode::MessageDecodeError,
+			  "Your session encoding is set to MsgPack, but a text message was received.",
+			  errorCode);
+			return;
+		} else if (!codec::IsBinary(encoding) && opCode != websocketpp::frame::opcode::text) {
+			transport->Close(
+			  WebSocketCloseCode::MessageDecodeError,
 			  "Your session encoding is set to Json, but a binary message was received.",
 			  errorCode);
 			return;
 		}
 
+		// Requests that exceed the limit are still decoded so they can be answered, but
+		// nothing of them reaches the UI thread
+		bool throttled = !session->InboundBucket().TryTake(WebSocketRateLimit::messagesPerSecond,
+								   WebSocketRateLimit::burst);
+		if (throttled) {
+			session->IncrementThrottledMessages();
+			if (session->ThrottledMessages() % 1000 == 1)
+				blog(LOG_WARNING,
+				     "[WebSocketServer::onMessage] Client `%s` exceeds the rate limit, %llu messages throttled",
+				     session->RemoteAddress().c_str(),
+				     (unsigned long long)session->ThrottledMessages());
+		}
+
+		// Commands are read straight from the payload, json11 only sees the other messages
+		if (encoding == WebSocketEncoding::Json) {
+			codec::RequestMessage request;
+			if (codec::DecodeJsonRequest(payload, request) &&
+			    request.op == WebSocketOpCode::Request) {
+				DispatchRequest(hdl, session,
+						Request{std::move(request.requestType),
+							std::move(request.requestId),
+							std::move(request.requestData), session},
+						throttled);
+				return;
+			}
+		}
+
+		json11::Json decoded;
+		std::string decodeError;
+		if (codec::Decode(encoding, payload, decoded, decodeError)) {
+			ProcessResult ret;
+			if (ProcessMessage(hdl, session, decoded, throttled, ret)) {
+				if (ret.closeCode != WebSocketCloseCode::DontClose)
+					transport->Close(ret.closeCode, ret.closeReason, errorCode);
+				return;
+			}
+		} else if (codec::IsBinary(encoding)) {
+			transport->Close(WebSocketCloseCode::MessageDecodeError,
+					 "Failed to decode your MsgPack message: " + decodeError,
+					 errorCode);
+			return;
+		}
+
+		if (throttled)
+			return;
+
+		// Not a protocol message, hand it to the listeners as is
 		WebSocketSessionState state;
+		state.sessionId = session->Id();
 		state.hdl = hdl;
 		state.remoteAddress = session->RemoteAddress();
 		state.connectedAt = session->ConnectedAt();
 		state.incomingMessages = session->IncomingMessages();
 		state.outgoingMessages = session->OutgoingMessages();
+		state.encoding = encoding;
 
-    blog(LOG_INFO, "[WebSocketServer::onOpen] Receive message from %s, content: %s",
-      session->RemoteAddress().c_str(), payload.c_str());
+		if (codec::IsBinary(encoding))
+			blog(LOG_INFO,
+			     "[WebSocketServer::onMessage] Receive message from %s, %zu bytes",
+			     session->RemoteAddress().c_str(), payload.size());
+		else
+			blog(LOG_INFO,
+			     "[WebSocketServer::onMessage] Receive message from %s, content: %s",
+			     session->RemoteAddress().c_str(), payload.c_str());
 
 		// Emit signals
 		emit ClientSentMessage(state, payload);
-	}));
+	});
 }
@@ -1,16 +1,31 @@
 #pragma once
 
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <unordered_map>
 
 #include <QObject>
 #include <QThreadPool>
 #include <QString>
 
 #include <asio.hpp>
-#include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 
+#include "websocket-config.h"
+
 #include "websocket-session.h"
+#include "session-registry.h"
+#include "message-codec.h"
+#include "request-handler.h"
+#include "stats-stream.h"
+#include "thumbnail-stream.h"
+#include "packet-stream.h"
+#include "event-publisher.h"
+#include "state-sync.h"
+#include "timer-wheel.h"
 
 enum WebSocketCloseCode {
 	DontClose = 0,
@@ -22,26 +37,80 @@ enum WebSocketCloseCode {
 	UnknownOpCode = 4006,
 	SessionInvalidated = 4010,
 	UnsupportedFeature = 4011,
+	SlowConsumer = 4012,
+	SessionTimeout = 4013,
+};
+
+namespace compat {
+// QThreadPool::start(std::function) needs Qt 5.15
+QRunnable* CreateFunctionRunnable(std::function<void()> func);
+} // namespace compat
+
+namespace WebSocketOpCode {
+enum WebSocketOpCode {
+	Event = 5,
+	Request = 6,
+	RequestResponse = 7,
+	RequestBatch = 8,
+	RequestBatchResponse = 9,
 };
+} // namespace WebSocketOpCode
 
 struct WebSocketSessionState {
+  SessionId sessionId;
   websocketpp::connection_hdl hdl;
   std::string remoteAddress;
   uint64_t connectedAt;
   uint64_t incomingMessages;
   uint64_t outgoingMessages;
+  WebSocketEncoding encoding;
 };
 Q_DECLARE_METATYPE(WebSocketSessionState)
 
+// An address and port the server accepts connections on
+struct WebSocketListener {
+	// numeric IPv4 or IPv6 address, "0.0.0.0" accepts on every IPv4 interface and "::" on
+	// every interface of both families
+	std::string address;
+	uint16_t port;
+	// let several sockets bind the same address and port, the kernel spreads incoming
+	// connections over them. Not available on Windows.
+	bool reusePort;
+};
+
 class WebSocketServer : public QObject {
 	Q_OBJECT
 
 public:
+	// frame serialized once and shared read-only by every receiver of a broadcast
+	typedef websocketpp::server<WebSocketConfig>::message_ptr SharedFrame;
+	typedef std::function<bool(const SessionPtr&)> SessionFilter;
+
 	WebSocketServer();
 	~WebSocketServer();
 
 	void Start();
 	void Stop();
+
+	// number of threads running the shared io_context, must be set before `Start()`
+	void SetIOThreadCount(size_t count);
+	size_t IOThreadCount() const { return ioThreadCount; }
+
+	// Where `Start()` listens, by default every IPv4 interface on port 8359. The first
+	// listener must bind for the server to start, the others are skipped when they fail.
+	// Can not be changed while listening.
+	void SetListeners(std::vector<WebSocketListener> listeners);
+	std::vector<WebSocketListener> Listeners() const { return listeners; }
+
+	// Also serve `wss://` on `listener` with a PEM certificate chain and private key. Must be
+	// set before `Start()`, an empty `certificateFile` disables the TLS endpoint.
+	void SetTlsOptions(const WebSocketListener& listener, const std::string& certificateFile,
+			   const std::string& privateKeyFile);
+	// Reread the certificate files for new connections, open ones keep the certificate they
+	// were accepted with. Session tickets issued before the reload stay valid.
+	bool ReloadTlsCertificate();
+	bool IsTlsListening() { return tlsServer.is_listening(); }
+
 	void InvalidateSession(websocketpp::connection_hdl hdl);
 
 	bool IsListening() { return server.is_listening(); }
@@ -51,10 +120,35 @@ public:
 	QThreadPool* GetThreadPool() { return &threadPool; }
 
 	void SendMessageToClient(const WebSocketSessionState& state, const char* msg);
+	// encode `msg` with the encoding the session negotiated and send it
+	void SendMessageToClient(const WebSocketSessionState& state, const json11::Json& msg);
+
+	// build a ready-to-write frame that any number of sessions can send without a copy
+	static SharedFrame MakeSharedFrame(const std::string& payload, bool binary);
+	// send `frame` to every session whose encoding matches the frame type, that subscribed
+	// to one of `topics` (0 means every session) and that passes `filter`, returns the
+	// number of receivers
+	size_t Broadcast(const SharedFrame& frame, uint32_t topics,
+			 const SessionFilter& filter = nullptr);
+	// serialize `event` at most once per encoding in use by the receivers and broadcast it
+	size_t Broadcast(const json11::Json& event, uint32_t topics,
+			 const SessionFilter& filter = nullptr);
+
+	// whether any session subscribed to one of `topics`, a single atomic load so event
+	// sources can check it before building anything
+	bool HasSubscribers(uint32_t topics) const { return (subscribedTopics & topics) != 0; }
+	// recompute the union of the session subscriptions after one of them changed
+	void UpdateSubscribedTopics();
+
+	// send an opaque binary frame built by `MakeSharedFrame` to every session of `topics`
+	// that passes `filter` whatever its encoding, the payload is never compressed again
+	size_t BroadcastMedia(const SharedFrame& frame, uint32_t topics,
+			      const SessionFilter& filter = nullptr);
 
 signals:
 	void ClientConnected(WebSocketSessionState state);
 	void ClientDisconnected(WebSocketSessionState state, uint16_t closeCode);
+	// `msg` is the raw frame payload, decode it with `codec::Decode(state.encoding, ...)`
 	void ClientSentMessage(WebSocketSessionState state, const std::string& msg);
 
 private:
@@ -64,21 +158,118 @@ private:
 		std::string result;
 	};
 
+	// Latest not yet processed request of one session for one `RequestHandler::CoalesceKey`,
+	// with the IDs of the requests it replaced. They are all answered with its result.
+	struct PendingRequest {
+		Request request;
+		std::vector<std::string> replacedIds;
+	};
+
 	void ServerRunner();
 
-	bool onValidate(websocketpp::connection_hdl hdl);
-	void onOpen(websocketpp::connection_hdl hdl);
-	void onClose(websocketpp::connection_hdl hdl);
-	void onMessage(websocketpp::connection_hdl hdl,
-		       websocketpp::server<websocketpp::config::asio>::message_ptr message);
+	// handle `{"op": ..., "d": {...}}` messages, returns false for anything else. Requests of
+	// a `throttled` message are answered with `TooManyRequests` without running them.
+	bool ProcessMessage(websocketpp::connection_hdl hdl, const SessionPtr& session,
+			    const json11::Json& message, bool throttled, ProcessResult& ret);
+	// answer `request` right away if `throttled`, queue it otherwise
+	void DispatchRequest(websocketpp::connection_hdl hdl, const SessionPtr& session,
+			     const Request& request, bool throttled);
+	// run `request`, or the latest request that replaced it, on the UI thread
+	void QueueRequest(websocketpp::connection_hdl hdl, const SessionPtr& session,
+			  const Request& request);
+	void SendJson(websocketpp::connection_hdl hdl, const SessionPtr& session,
+		      const json11::Json& msg);
+
+	SessionRegistry::Snapshot CollectReceivers(uint32_t topics, const SessionFilter& filter);
+	// unprepared message, compressed by sessions with deflate if above the threshold
+	static SharedFrame MakeMessage(const std::string& payload, bool binary);
+	// queue `frame` on the session, `topic` 0 marks messages that must not be dropped
+	void SendFrame(websocketpp::connection_hdl hdl, const SessionPtr& session,
+		       const SharedFrame& frame, uint32_t topic = 0);
+	void SendSharedFrame(websocketpp::connection_hdl hdl, const SessionPtr& session,
+			     const SharedFrame& frame, SharedFrame& deflatable, uint32_t topic);
+	// hand queued frames to websocketpp while its write buffer has room
+	void PumpOutbound(websocketpp::connection_hdl hdl, const SessionPtr& session);
+
+	// check the liveness of `id` again at steady clock `atMs`
+	void ScheduleHeartbeat(SessionId id, int64_t atMs);
+	// ping or close the sessions whose heartbeat is due, runs on an IO thread every tick
+	void HeartbeatTick();
+	void CheckHeartbeat(const SessionEntry& entry, int64_t nowMs);
+
+	typedef std::shared_ptr<websocketpp::lib::asio::ssl::context> TlsContextPtr;
+	// a server context for the configured files, nullptr if they can not be loaded
+	TlsContextPtr CreateTlsContext();
+
+	// the same handlers serve every endpoint
+	template<typename Endpoint> void InitEndpoint(Endpoint& endpoint, bool secure);
+	// bind and start accepting, logs and returns false on failure
+	template<typename Endpoint>
+	bool Listen(Endpoint& endpoint, const WebSocketListener& listener);
+	template<typename Endpoint>
+	bool onValidate(Endpoint& endpoint, websocketpp::connection_hdl hdl);
+	template<typename Endpoint>
+	void onOpen(Endpoint& endpoint, websocketpp::connection_hdl hdl, bool secure);
+	template<typename Endpoint>
+	void onClose(Endpoint& endpoint, websocketpp::connection_hdl hdl);
+	template<typename Endpoint>
+	void onPong(Endpoint& endpoint, websocketpp::connection_hdl hdl);
+	template<typename Endpoint>
+	void onMessage(Endpoint& endpoint, websocketpp::connection_hdl hdl,
+		       typename Endpoint::message_ptr message);
 
 	QThreadPool threadPool;
 
-	std::thread serverThread;
-	websocketpp::server<websocketpp::config::asio> server;
+	// only used on the thread the server lives on
+	StatsStream statsStream;
+	ThumbnailStream thumbnailStream;
+	PacketStream packetStream;
+	EventPublisher eventPublisher;
+	StateSync stateSync;
+	RequestHandler requestHandler;
+
+	// all of them run `server.run()` on the same io_context, handlers of one connection are
+	// serialized by the per-connection strand websocketpp creates for multithreaded configs
+	size_t ioThreadCount;
+	std::vector<std::thread> serverThreads;
+	// owns the io_context and the timers, and serves the first listener
+	websocketpp::server<WebSocketConfig> server;
+	std::vector<WebSocketListener> listeners;
+	// one per further listener, kept until destruction since sessions refer to them
+	std::vector<std::unique_ptr<websocketpp::server<WebSocketConfig>>> extraEndpoints;
+	// runs on the io_context of `server`, only listens when TLS is configured
+	websocketpp::server<WebSocketTlsConfig> tlsServer;
+
+	// the context handed to new TLS connections, replaced by `ReloadTlsCertificate()`
+	std::mutex tlsMutex;
+	TlsContextPtr tlsContext;
+	WebSocketListener tlsListener;
+	std::string tlsCertificateFile;
+	std::string tlsPrivateKeyFile;
+	// session ticket keys, generated once so tickets survive certificate reloads
+	unsigned char tlsTicketKeys[80];
+
+	SessionRegistry sessions;
+
+	// one wheel instead of one asio timer per session, ticks are `heartbeatTickMs` long and
+	// counted from `heartbeatEpochMs`
+	TimerWheel<SessionId> heartbeats;
+	int64_t heartbeatEpochMs = 0;
+	int64_t heartbeatTickMs = 500;
+
+	// bumped by `Stop()`, `io_context::stop()` leaves timer waits pending and their callbacks
+	// run after the next `Start()`, a callback of an older run returns right away
+	std::atomic<uint64_t> runGeneration = 0;
+
+	// keyed by session ID and `RequestHandler::CoalesceKey`
+	std::mutex pendingRequestsMutex;
+	std::unordered_map<std::string, PendingRequest> pendingRequests;
+
+	// union of the `EventSubscriptions()` of every session
+	std::atomic<uint32_t> subscribedTopics = 0;
+	std::mutex subscribedTopicsMutex;
 
-	std::mutex sessionMutex;
-	std::map<websocketpp::connection_hdl, SessionPtr,
-		 std::owner_less<websocketpp::connection_hdl>>
-	  sessions;
+	// wakes `Stop()` whenever a session is removed
+	std::mutex stopMutex;
+	std::condition_variable sessionsClosed;
 };